@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "alloc_tracker.h"
+#include "planner.h"
+#include "recorder.h"
+
+// Feeds a fixed corpus of recorded telemetry through the planner and checks the heap use of every
+// stage against a budget of allocations per frame. Needs a build with PLANNER_ALLOC_TRACKING. Each
+// log gets a fresh planner, whose first frames only warm its buffers up and are not checked. Exits
+// with 1 if any checked frame allocates more in a stage than the stage's budget, 0 by default.
+//
+//   alloc_budget <log>... [--map ../data/highway_map.csv] [--warmup N] [--budget STAGE=N]...
+//
+// STAGE is parse, predict, detect, cost, generate, serialize, frame (the frame outside of the other
+// stages) or all.
+
+namespace
+{
+
+const int kSlots = (int) PlannerStage::kCount + 1;
+
+const char *slotName(int slot)
+{
+    return slot == (int) PlannerStage::kCount ? "outside" : stageName((PlannerStage) slot);
+}
+
+// Heap use of one stage over the checked frames
+struct StageUsage
+{
+    uint64_t frames = 0;
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t max_allocations = 0;
+    uint64_t max_bytes = 0;
+    uint64_t over_budget = 0;
+    // first frame over the budget
+    std::string worst_log;
+    uint64_t worst_frame = 0;
+};
+
+void snapshot(StageAllocations (&counts)[kSlots])
+{
+    for (int s = 0; s < kSlots; s++)
+    {
+        counts[s] = threadStageAllocations((PlannerStage) s);
+    }
+}
+
+bool parseBudget(const std::string &arg, long (&budgets)[kSlots])
+{
+    size_t eq = arg.find('=');
+    if (eq == std::string::npos)
+    {
+        return false;
+    }
+    std::string name = arg.substr(0, eq);
+    long budget = atol(arg.c_str() + eq + 1);
+    for (int s = 0; s < kSlots; s++)
+    {
+        if (name == "all" || name == slotName(s))
+        {
+            budgets[s] = budget;
+            if (name != "all")
+            {
+                return true;
+            }
+        }
+    }
+    return name == "all";
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    std::vector<std::string> logs;
+    std::string map_file = "../data/highway_map.csv";
+    int warmup = 50;
+    long budgets[kSlots];
+    std::fill(budgets, budgets + kSlots, 0);
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--map" && i + 1 < argc)
+        {
+            map_file = argv[++i];
+        }
+        else if (arg == "--warmup" && i + 1 < argc)
+        {
+            warmup = std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--budget" && i + 1 < argc)
+        {
+            if (!parseBudget(argv[++i], budgets))
+            {
+                std::cerr << "Bad budget " << argv[i] << std::endl;
+                return 2;
+            }
+        }
+        else
+        {
+            logs.push_back(arg);
+        }
+    }
+    if (logs.empty())
+    {
+        std::cerr << "usage: " << argv[0] << " <log>... [--map highway_map.csv] [--warmup N] [--budget STAGE=N]"
+                  << std::endl;
+        return 2;
+    }
+    if (!allocationTrackingEnabled())
+    {
+        std::cerr << "Allocations are not tracked in this build; configure with -DPLANNER_ALLOC_TRACKING=ON"
+                  << std::endl;
+        return 2;
+    }
+
+    HighwayMap map;
+    if (!loadHighwayMap(map_file, map))
+    {
+        std::cerr << "Failed to load the map " << map_file << std::endl;
+        return 2;
+    }
+
+    StageUsage usage[kSlots];
+    StageAllocations before[kSlots];
+    StageAllocations after[kSlots];
+    std::string reply;
+    for (const std::string &log : logs)
+    {
+        // the telemetry of the log is read up front, so reading it does not count against the planner
+        std::vector<std::string> frames;
+        {
+            TelemetryLogReader reader;
+            if (!reader.open(log))
+            {
+                std::cerr << "Failed to open the log " << log << std::endl;
+                return 2;
+            }
+            LogRecord record;
+            while (reader.next(record))
+            {
+                if (record.type == RecordType::kTelemetry)
+                {
+                    frames.push_back(record.payload);
+                }
+            }
+        }
+
+        Planner planner(map);
+        for (size_t f = 0; f < frames.size(); f++)
+        {
+            snapshot(before);
+            planner.handleMessage(frames[f].data(), frames[f].size(), reply);
+            snapshot(after);
+            if ((int) f < warmup)
+            {
+                continue;
+            }
+
+            for (int s = 0; s < kSlots; s++)
+            {
+                uint64_t allocations = after[s].allocations - before[s].allocations;
+                uint64_t bytes = after[s].bytes - before[s].bytes;
+                StageUsage &u = usage[s];
+                u.frames++;
+                u.allocations += allocations;
+                u.bytes += bytes;
+                u.max_allocations = std::max(u.max_allocations, allocations);
+                u.max_bytes = std::max(u.max_bytes, bytes);
+                if ((long) allocations > budgets[s])
+                {
+                    if (u.over_budget == 0)
+                    {
+                        u.worst_log = log;
+                        u.worst_frame = f;
+                    }
+                    u.over_budget++;
+                }
+            }
+        }
+    }
+
+    bool failed = false;
+    std::printf("%-10s %8s %12s %10s %14s %10s %8s %8s\n", "stage", "frames", "allocations", "max/frame",
+            "bytes", "max bytes", "budget", "over");
+    for (int s = 0; s < kSlots; s++)
+    {
+        const StageUsage &u = usage[s];
+        std::printf("%-10s %8llu %12llu %10llu %14llu %10llu %8ld %8llu\n", slotName(s),
+                (unsigned long long) u.frames, (unsigned long long) u.allocations,
+                (unsigned long long) u.max_allocations, (unsigned long long) u.bytes,
+                (unsigned long long) u.max_bytes, budgets[s], (unsigned long long) u.over_budget);
+        failed = failed || u.over_budget > 0;
+    }
+    for (int s = 0; s < kSlots; s++)
+    {
+        if (usage[s].over_budget > 0)
+        {
+            std::printf("%s over budget first in frame %llu of %s\n", slotName(s),
+                    (unsigned long long) usage[s].worst_frame, usage[s].worst_log.c_str());
+        }
+    }
+    std::printf("%s\n", failed ? "FAILED" : "passed");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,139 @@
+#include "alloc_tracker.h"
+#include <cstdlib>
+#include <new>
+
+namespace
+{
+
+const int kSlots = (int) PlannerStage::kCount + 1;
+
+struct AllocationCounts
+{
+    uint64_t allocations;
+    uint64_t bytes;
+    uint64_t frees;
+};
+
+// Plain zero-initialized thread_locals: operator new may run at any point of a thread's life, before
+// or after anything with a constructor
+thread_local AllocationCounts thread_counts[kSlots];
+#ifdef PLANNER_ALLOC_TRACKING
+thread_local int thread_stage = (int) PlannerStage::kCount;
+#endif
+
+}  // namespace
+
+StageAllocations threadStageAllocations(PlannerStage stage)
+{
+    StageAllocations result;
+    const AllocationCounts &counts = thread_counts[(int) stage];
+    result.allocations = counts.allocations;
+    result.bytes = counts.bytes;
+    result.frees = counts.frees;
+    return result;
+}
+
+#ifdef PLANNER_ALLOC_TRACKING
+
+bool allocationTrackingEnabled()
+{
+    return true;
+}
+
+PlannerStage enterAllocationStage(PlannerStage stage)
+{
+    PlannerStage outer = (PlannerStage) thread_stage;
+    thread_stage = (int) stage;
+    return outer;
+}
+
+void leaveAllocationStage(PlannerStage outer)
+{
+    thread_stage = (int) outer;
+}
+
+namespace
+{
+
+void *countedAllocate(std::size_t size)
+{
+    AllocationCounts &counts = thread_counts[thread_stage];
+    counts.allocations++;
+    counts.bytes += size;
+    return std::malloc(size > 0 ? size : 1);
+}
+
+void countedFree(void *p)
+{
+    if (p != nullptr)
+    {
+        thread_counts[thread_stage].frees++;
+        std::free(p);
+    }
+}
+
+}  // namespace
+
+void *operator new(std::size_t size)
+{
+    void *p = countedAllocate(size);
+    if (p == nullptr)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocate(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept
+{
+    return countedAllocate(size);
+}
+
+void operator delete(void *p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, std::size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, std::size_t) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    countedFree(p);
+}
+
+#else
+
+bool allocationTrackingEnabled()
+{
+    return false;
+}
+
+#endif // PLANNER_ALLOC_TRACKING
@@ -0,0 +1,24 @@
+#ifndef ALLOC_TRACKER_H
+#define ALLOC_TRACKER_H
+
+#include <cstdint>
+#include "stage_timer.h"
+
+// Heap use of one stage
+struct StageAllocations
+{
+    uint64_t allocations = 0;
+    uint64_t bytes = 0;
+    uint64_t frees = 0;
+};
+
+// True in a build with PLANNER_ALLOC_TRACKING, which replaces the global operator new and delete to
+// count every call against the innermost StageTimer running on the calling thread. Without it the
+// counts below stay zero.
+bool allocationTrackingEnabled();
+
+// Heap use of the calling thread in a stage since the thread started. Stage kCount holds what was
+// allocated outside of any stage.
+StageAllocations threadStageAllocations(PlannerStage stage);
+
+#endif // ALLOC_TRACKER_H
@@ -0,0 +1,269 @@
+#include "behavior.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+
+// resolution of the state a successor is cached by
+const double kCacheS = 0.5;     // [m]
+const double kCacheV = 0.25;    // [m/s]
+
+int laneOffset(Maneuver maneuver)
+{
+    return maneuver == Maneuver::kChangeLeft ? -1 : (maneuver == Maneuver::kChangeRight ? 1 : 0);
+}
+
+}  // namespace
+
+BehaviorSearch::BehaviorSearch(std::size_t max_vehicles)
+    : vehicles_(0), generation_(0), origin_s_(0.0), rollouts_(0), cache_hits_(0)
+{
+    int samples = (int) (BehaviorPlan::kMaxDepth * config.maneuver_time / config.dt) + 1;
+    s_.reserve(max_vehicles * samples);
+    v_.reserve(max_vehicles * samples);
+    lanes_.reserve(max_vehicles * samples);
+    beam_.reserve(config.beam_width);
+    children_.reserve(3 * config.beam_width);
+    cache_.resize(config.cache_slots);
+}
+
+void BehaviorSearch::sampleTraffic(const TrafficPrediction &prediction, double t0, int samples)
+{
+    vehicles_ = prediction.vehicles();
+    s_.resize(vehicles_ * samples);
+    v_.resize(vehicles_ * samples);
+    lanes_.resize(vehicles_ * samples);
+
+    // past the horizon of the prediction the cars go on at their last predicted speed
+    int last = prediction.steps();
+    double pdt = prediction.dt();
+    for (std::size_t i = 0; i < vehicles_; i++)
+    {
+        double v_end = (last > 0) ? (prediction.s(last, i) - prediction.s(last - 1, i)) / pdt : prediction.speed(i);
+        for (int k = 0; k < samples; k++)
+        {
+            double f = (t0 + k * config.dt) / pdt;
+            double s, v, d;
+            if (f < last)
+            {
+                int step = (int) f;
+                double w = f - step;
+                s = (1.0 - w) * prediction.s(step, i) + w * prediction.s(step + 1, i);
+                d = (1.0 - w) * prediction.d(step, i) + w * prediction.d(step + 1, i);
+                v = (prediction.s(step + 1, i) - prediction.s(step, i)) / pdt;
+            }
+            else
+            {
+                s = prediction.s(last, i) + v_end * (f - last) * pdt;
+                d = prediction.d(last, i);
+                v = v_end;
+            }
+
+            // every lane the car's width reaches into
+            int lo = std::max(0, (int) floor((d - 0.5 * config.car_width) / config.lane_width));
+            int hi = std::min(config.num_lanes - 1, (int) floor((d + 0.5 * config.car_width) / config.lane_width));
+            std::uint8_t mask = 0;
+            for (int lane = lo; lane <= hi; lane++)
+            {
+                mask |= (std::uint8_t) (1u << lane);
+            }
+
+            std::size_t index = k * vehicles_ + i;
+            s_[index] = s;
+            v_[index] = v;
+            lanes_[index] = mask;
+        }
+    }
+}
+
+BehaviorSearch::Outcome BehaviorSearch::rollout(double s, double v, int from_lane, int to_lane,
+        int first_sample) const
+{
+    int steps = std::max(1, (int) lround(config.maneuver_time / config.dt));
+    // a lane change occupies both lanes for the whole maneuver
+    std::uint8_t occupied = (std::uint8_t) ((1u << from_lane) | (1u << to_lane));
+    std::uint8_t entered = (to_lane != from_lane) ? (std::uint8_t) (1u << to_lane) : 0;
+    double max_dv = config.max_accel * config.dt;
+    bool collided = false;
+    double start_s = s;
+
+    for (int k = 0; k < steps; k++)
+    {
+        const double *cars_s = &s_[(first_sample + k) * vehicles_];
+        const double *cars_v = &v_[(first_sample + k) * vehicles_];
+        const std::uint8_t *cars_lanes = &lanes_[(first_sample + k) * vehicles_];
+        double leader_gap = INFINITY;
+        double leader_v = config.max_speed;
+        for (std::size_t i = 0; i < vehicles_; i++)
+        {
+            if ((cars_lanes[i] & occupied) == 0)
+            {
+                continue;
+            }
+            double gap = cars_s[i] - s;
+            if (gap >= 0.0 && gap < leader_gap)
+            {
+                leader_gap = gap;
+                leader_v = cars_v[i];
+            }
+            else if (gap < 0.0 && (cars_lanes[i] & entered) != 0 && -gap < config.cut_in_gap)
+            {
+                collided = true;
+            }
+        }
+        collided = collided || leader_gap < config.min_gap;
+
+        double target = config.max_speed;
+        if (leader_gap < v * config.headway + config.min_gap)
+        {
+            target = std::min(target, leader_v);
+        }
+        v = std::max(0.0, v + std::max(-max_dv, std::min(max_dv, target - v)));
+        s += v * config.dt;
+    }
+
+    Outcome outcome;
+    outcome.s = s;
+    outcome.v = v;
+    outcome.reward = (s - start_s) - (entered != 0 ? config.lane_change_cost : 0.0) -
+                     (collided ? config.collision_cost : 0.0);
+    return outcome;
+}
+
+std::uint64_t BehaviorSearch::stateKey(int lane, double s, double v) const
+{
+    std::int64_t s_bin = (std::int64_t) floor((s - origin_s_) / kCacheS) + (1 << 19);
+    std::int64_t v_bin = (std::int64_t) floor(v / kCacheV);
+    s_bin = std::max<std::int64_t>(0, std::min<std::int64_t>(s_bin, (1 << 20) - 1));
+    v_bin = std::max<std::int64_t>(0, std::min<std::int64_t>(v_bin, (1 << 10) - 1));
+    return (std::uint64_t) s_bin | ((std::uint64_t) v_bin << 20) | ((std::uint64_t) lane << 30);
+}
+
+BehaviorSearch::Outcome BehaviorSearch::expand(const Node &node, int level, Maneuver maneuver, int to_lane)
+{
+    int steps = std::max(1, (int) lround(config.maneuver_time / config.dt));
+    std::uint64_t key = stateKey(node.lane, node.s, node.v) | ((std::uint64_t) level << 34) |
+                        ((std::uint64_t) maneuver << 38);
+
+    // open addressing over a few slots; a slot of an older search counts as empty
+    std::size_t mask = cache_.size() - 1;
+    std::size_t slot = (std::size_t) ((key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    for (int probe = 0; probe < 8; probe++, slot = (slot + 1) & mask)
+    {
+        CacheSlot &entry = cache_[slot];
+        if (entry.generation == generation_ && entry.key == key)
+        {
+            cache_hits_++;
+            return entry.outcome;
+        }
+        if (entry.generation != generation_)
+        {
+            rollouts_++;
+            entry.key = key;
+            entry.generation = generation_;
+            entry.outcome = rollout(node.s, node.v, node.lane, to_lane, level * steps);
+            return entry.outcome;
+        }
+    }
+    // the neighborhood is full: roll out without caching
+    rollouts_++;
+    return rollout(node.s, node.v, node.lane, to_lane, level * steps);
+}
+
+void BehaviorSearch::search(const TrafficPrediction &prediction, double s, double v, int lane, double t0,
+        BehaviorPlan &plan, std::chrono::steady_clock::time_point deadline)
+{
+    int depth = std::max(1, std::min(config.depth, (int) BehaviorPlan::kMaxDepth));
+    std::size_t width = (std::size_t) std::max(1, config.beam_width);
+    int steps = std::max(1, (int) lround(config.maneuver_time / config.dt));
+    sampleTraffic(prediction, t0, depth * steps + 1);
+
+    // the cache size is rounded up to a power of two
+    std::size_t slots = 1;
+    while (slots < (std::size_t) std::max(1, config.cache_slots))
+    {
+        slots <<= 1;
+    }
+    if (cache_.size() != slots)
+    {
+        cache_.assign(slots, CacheSlot());
+        generation_ = 0;
+    }
+    if (++generation_ == 0)
+    {
+        std::fill(cache_.begin(), cache_.end(), CacheSlot());
+        generation_ = 1;
+    }
+    origin_s_ = s;
+    rollouts_ = 0;
+    cache_hits_ = 0;
+
+    beam_.clear();
+    Node root;
+    root.lane = lane;
+    root.s = s;
+    root.v = v;
+    root.score = 0.0;
+    beam_.push_back(root);
+    plan.depth = 0;
+
+    for (int level = 0; level < depth; level++)
+    {
+        if (level > 0 && deadline != std::chrono::steady_clock::time_point::max() &&
+            std::chrono::steady_clock::now() >= deadline)
+        {
+            break;
+        }
+
+        children_.clear();
+        for (const Node &node : beam_)
+        {
+            for (Maneuver maneuver : {Maneuver::kKeepLane, Maneuver::kChangeLeft, Maneuver::kChangeRight})
+            {
+                int to_lane = node.lane + laneOffset(maneuver);
+                if (to_lane < 0 || to_lane >= config.num_lanes)
+                {
+                    continue;
+                }
+                Outcome outcome = expand(node, level, maneuver, to_lane);
+                Node child = node;
+                child.lane = to_lane;
+                child.s = outcome.s;
+                child.v = outcome.v;
+                child.score = node.score + outcome.reward;
+                child.maneuvers[level] = maneuver;
+                children_.push_back(child);
+            }
+        }
+
+        // keep the best sequences, one per first maneuver and state
+        std::sort(children_.begin(), children_.end(), [](const Node &a, const Node &b) {
+            return a.score > b.score;
+        });
+        beam_.clear();
+        for (const Node &child : children_)
+        {
+            if (beam_.size() == width)
+            {
+                break;
+            }
+            std::uint64_t key = stateKey(child.lane, child.s, child.v);
+            bool merged = false;
+            for (const Node &kept : beam_)
+            {
+                merged = merged || (kept.maneuvers[0] == child.maneuvers[0] &&
+                                    stateKey(kept.lane, kept.s, kept.v) == key);
+            }
+            if (!merged)
+            {
+                beam_.push_back(child);
+            }
+        }
+        plan.depth = level + 1;
+    }
+
+    const Node &best = beam_.front();
+    std::copy(best.maneuvers, best.maneuvers + plan.depth, plan.maneuvers);
+    plan.score = best.score;
+}
@@ -0,0 +1,118 @@
+#ifndef BEHAVIOR_H
+#define BEHAVIOR_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "prediction.h"
+
+struct BehaviorConfig
+{
+    int depth = 3;                  // maneuvers per sequence, at most BehaviorPlan::kMaxDepth
+    int beam_width = 6;             // sequences kept after every maneuver
+    double maneuver_time = 1.5;     // duration of one maneuver [s]
+    double dt = 0.1;                // time step of the rollout of a maneuver [s]
+    double max_speed = 21.9;        // speed the ego drives at on a free lane [m/s]
+    double max_accel = 5.0;         // [m/s2]
+    double headway = 1.0;           // time gap to the car ahead below which the ego follows it [s]
+    double min_gap = 8.0;           // closer than this to the car ahead counts as a collision [m]
+    double cut_in_gap = 10.0;       // same for a car behind in the lane the ego moves into [m]
+    double lane_change_cost = 5.0;  // progress a lane change has to gain to be worth it [m]
+    double collision_cost = 200.0;  // per maneuver with a collision [m]
+    int num_lanes = 3;
+    double lane_width = 4.0;
+    double car_width = 2.0;
+    // slots of the successor cache, a power of two
+    int cache_slots = 256;
+};
+
+enum class Maneuver : std::uint8_t
+{
+    kKeepLane,
+    kChangeLeft,
+    kChangeRight,
+};
+
+// Best maneuver sequence found by BehaviorSearch::search
+struct BehaviorPlan
+{
+    static const int kMaxDepth = 8;
+
+    Maneuver maneuvers[kMaxDepth];
+    // maneuvers searched to; less than the configured depth if the deadline cut the search short
+    int depth = 0;
+    // progress over the horizon minus the costs of the sequence [m]
+    double score = 0.0;
+
+    Maneuver first() const { return depth > 0 ? maneuvers[0] : Maneuver::kKeepLane; }
+};
+
+// Short-horizon behavior lookahead: beam search over sequences of lane keeps and changes, each
+// rolled out for maneuver_time against the predicted traffic. The ego follows the car ahead in the
+// lanes it occupies, and a sequence scores the distance it makes minus lane change and collision
+// costs. Successors are cached by (depth, lane, s, speed, maneuver), so nodes that reach the same
+// state along different sequences roll each maneuver out once; nodes with the same state and the
+// same first maneuver are merged, as they stand for the same decision.
+class BehaviorSearch
+{
+public:
+    explicit BehaviorSearch(std::size_t max_vehicles = 64);
+
+    // Search from an ego in lane at s and speed v [m/s], t0 seconds from now. Levels not started by
+    // the deadline are left out; the first level is always searched.
+    void search(const TrafficPrediction &prediction, double s, double v, int lane, double t0, BehaviorPlan &plan,
+            std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+    BehaviorConfig config;
+
+    // maneuvers rolled out and taken from the cache by the last search
+    int rollouts() const { return rollouts_; }
+    int cacheHits() const { return cache_hits_; }
+
+private:
+    struct Node
+    {
+        int lane;
+        double s;
+        double v;
+        double score;
+        Maneuver maneuvers[BehaviorPlan::kMaxDepth];
+    };
+
+    // Where a maneuver leaves the ego and what it earned
+    struct Outcome
+    {
+        double s;
+        double v;
+        double reward;
+    };
+
+    struct CacheSlot
+    {
+        std::uint64_t key;
+        std::uint32_t generation;
+        Outcome outcome;
+    };
+
+    void sampleTraffic(const TrafficPrediction &prediction, double t0, int samples);
+    Outcome expand(const Node &node, int level, Maneuver maneuver, int to_lane);
+    Outcome rollout(double s, double v, int from_lane, int to_lane, int first_sample) const;
+    std::uint64_t stateKey(int lane, double s, double v) const;
+
+    // traffic at the rollout times t0 + k * dt: s, speed and the lanes it covers as a bit mask
+    std::size_t vehicles_;
+    std::vector<double> s_;
+    std::vector<double> v_;
+    std::vector<std::uint8_t> lanes_;
+
+    std::vector<Node> beam_;
+    std::vector<Node> children_;
+    std::vector<CacheSlot> cache_;
+    std::uint32_t generation_;
+    double origin_s_;
+    int rollouts_;
+    int cache_hits_;
+};
+
+#endif // BEHAVIOR_H
@@ -0,0 +1,386 @@
+#include "collision.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define COLLISION_HAVE_AVX_KERNEL 1
+#endif
+
+namespace
+{
+
+// Separating-axis test of one ego sample against the car, in plain C++
+bool obbOverlap(const ObbExtents &e, double ax, double ay, double ca, double sa, double bx, double by, double cb,
+        double sb)
+{
+    double tx = bx - ax;
+    double ty = by - ay;
+    double ac = fabs(ca * cb + sa * sb);
+    double as = fabs(sa * cb - ca * sb);
+    // same order of operations as the AVX kernel, so both give bit-identical answers
+    if (fabs(tx * ca + ty * sa) > e.ha + (e.hb * ac + e.wb * as)) return false;
+    if (fabs(ty * ca - tx * sa) > e.wa + (e.hb * as + e.wb * ac)) return false;
+    if (fabs(tx * cb + ty * sb) > e.hb + (e.ha * ac + e.wa * as)) return false;
+    if (fabs(ty * cb - tx * sb) > e.wb + (e.ha * as + e.wa * ac)) return false;
+    return true;
+}
+
+int firstContactScalar(const ObbExtents &e, const double *ax, const double *ay, const double *ca,
+        const double *sa, const double *bx, const double *by, const double *cb, const double *sb, int n)
+{
+    for (int k = 0; k < n; k++)
+    {
+        if (obbOverlap(e, ax[k], ay[k], ca[k], sa[k], bx[k], by[k], cb[k], sb[k]))
+        {
+            return k;
+        }
+    }
+    return -1;
+}
+
+#ifdef COLLISION_HAVE_AVX_KERNEL
+// Same test, four samples per iteration. The sample arrays are padded to a multiple of 4.
+__attribute__((target("avx")))
+int firstContactAvx(const ObbExtents &e, const double *ax, const double *ay, const double *ca,
+        const double *sa, const double *bx, const double *by, const double *cb, const double *sb, int n)
+{
+    const __m256d sign = _mm256_set1_pd(-0.0);
+    const __m256d ha = _mm256_set1_pd(e.ha);
+    const __m256d wa = _mm256_set1_pd(e.wa);
+    const __m256d hb = _mm256_set1_pd(e.hb);
+    const __m256d wb = _mm256_set1_pd(e.wb);
+
+    for (int k = 0; k < n; k += 4)
+    {
+        __m256d c = _mm256_loadu_pd(ca + k);
+        __m256d s = _mm256_loadu_pd(sa + k);
+        __m256d c2 = _mm256_loadu_pd(cb + k);
+        __m256d s2 = _mm256_loadu_pd(sb + k);
+        __m256d tx = _mm256_sub_pd(_mm256_loadu_pd(bx + k), _mm256_loadu_pd(ax + k));
+        __m256d ty = _mm256_sub_pd(_mm256_loadu_pd(by + k), _mm256_loadu_pd(ay + k));
+
+        __m256d ac = _mm256_andnot_pd(sign, _mm256_add_pd(_mm256_mul_pd(c, c2), _mm256_mul_pd(s, s2)));
+        __m256d as = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_mul_pd(s, c2), _mm256_mul_pd(c, s2)));
+
+        // projections of the center offset on the four axes
+        __m256d pa1 = _mm256_andnot_pd(sign, _mm256_add_pd(_mm256_mul_pd(tx, c), _mm256_mul_pd(ty, s)));
+        __m256d pa2 = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_mul_pd(ty, c), _mm256_mul_pd(tx, s)));
+        __m256d pb1 = _mm256_andnot_pd(sign, _mm256_add_pd(_mm256_mul_pd(tx, c2), _mm256_mul_pd(ty, s2)));
+        __m256d pb2 = _mm256_andnot_pd(sign, _mm256_sub_pd(_mm256_mul_pd(ty, c2), _mm256_mul_pd(tx, s2)));
+
+        // projected radii of both boxes on the four axes
+        __m256d ra1 = _mm256_add_pd(ha, _mm256_add_pd(_mm256_mul_pd(hb, ac), _mm256_mul_pd(wb, as)));
+        __m256d ra2 = _mm256_add_pd(wa, _mm256_add_pd(_mm256_mul_pd(hb, as), _mm256_mul_pd(wb, ac)));
+        __m256d rb1 = _mm256_add_pd(hb, _mm256_add_pd(_mm256_mul_pd(ha, ac), _mm256_mul_pd(wa, as)));
+        __m256d rb2 = _mm256_add_pd(wb, _mm256_add_pd(_mm256_mul_pd(ha, as), _mm256_mul_pd(wa, ac)));
+
+        // overlap when no axis separates the boxes
+        __m256d hit = _mm256_and_pd(_mm256_and_pd(_mm256_cmp_pd(pa1, ra1, _CMP_LE_OQ),
+                                                  _mm256_cmp_pd(pa2, ra2, _CMP_LE_OQ)),
+                                    _mm256_and_pd(_mm256_cmp_pd(pb1, rb1, _CMP_LE_OQ),
+                                                  _mm256_cmp_pd(pb2, rb2, _CMP_LE_OQ)));
+        int mask = _mm256_movemask_pd(hit);
+        if (mask)
+        {
+            int k_hit = k + __builtin_ctz(mask);
+            return k_hit < n ? k_hit : -1;
+        }
+    }
+    return -1;
+}
+
+bool cpuHasAvx()
+{
+    static const bool has_avx = __builtin_cpu_supports("avx");
+    return has_avx;
+}
+#endif
+
+// Pad a sample array to a multiple of 4 by repeating its last sample, which can only report
+// contacts that are discarded
+void padSamples(std::vector<double> &samples, int n)
+{
+    if (n <= 0)
+    {
+        return;
+    }
+    for (std::size_t k = n; k < samples.size(); k++)
+    {
+        samples[k] = samples[n - 1];
+    }
+}
+
+}  // namespace
+
+bool obbKernelAvailable(ObbKernel kernel)
+{
+#ifdef COLLISION_HAVE_AVX_KERNEL
+    return kernel == ObbKernel::kScalar || cpuHasAvx();
+#else
+    return kernel == ObbKernel::kScalar;
+#endif
+}
+
+int obbFirstContact(ObbKernel kernel, const ObbExtents &extents, const double *ax, const double *ay,
+        const double *ac, const double *as, const double *bx, const double *by, const double *bc,
+        const double *bs, int n)
+{
+#ifdef COLLISION_HAVE_AVX_KERNEL
+    if (kernel == ObbKernel::kAvx)
+    {
+        return firstContactAvx(extents, ax, ay, ac, as, bx, by, bc, bs, n);
+    }
+#endif
+    return firstContactScalar(extents, ax, ay, ac, as, bx, by, bc, bs, n);
+}
+
+ObbCollisionChecker::ObbCollisionChecker(std::size_t max_vehicles, int max_samples)
+    : maps_s_(nullptr), maps_x_(nullptr), maps_y_(nullptr)
+{
+    std::size_t padded = (max_samples + 3) & ~3;
+    cx_.reserve(padded);
+    cy_.reserve(padded);
+    cos_.reserve(padded);
+    sin_.reserve(padded);
+    t_.reserve(padded);
+    bx_.reserve(padded);
+    by_.reserve(padded);
+    bcos_.reserve(padded);
+    bsin_.reserve(padded);
+    order_.reserve(max_vehicles);
+    s_lo_.reserve(max_vehicles);
+    s_hi_.reserve(max_vehicles);
+    candidates_.reserve(max_vehicles);
+}
+
+void ObbCollisionChecker::setMap(const std::vector<double> &maps_s, const std::vector<double> &maps_x,
+        const std::vector<double> &maps_y)
+{
+    maps_s_ = &maps_s;
+    maps_x_ = &maps_x;
+    maps_y_ = &maps_y;
+}
+
+// Box centers and headings of the ego along the path, in SoA form
+void ObbCollisionChecker::prepareSamples(const double *x, const double *y, int n, double t0)
+{
+    std::size_t padded = (n + 3) & ~3;
+    cx_.resize(padded);
+    cy_.resize(padded);
+    cos_.resize(padded);
+    sin_.resize(padded);
+    t_.resize(padded);
+
+    double heading = 0.0;
+    for (int k = 0; k < n; k++)
+    {
+        // heading of the segment leaving the point; the last point keeps the previous heading
+        if (k + 1 < n)
+        {
+            heading = atan2(y[k + 1] - y[k], x[k + 1] - x[k]);
+        }
+        cx_[k] = x[k];
+        cy_[k] = y[k];
+        cos_[k] = cos(heading);
+        sin_[k] = sin(heading);
+        t_[k] = t0 + k * config.dt;
+    }
+    padSamples(cx_, n);
+    padSamples(cy_, n);
+    padSamples(cos_, n);
+    padSamples(sin_, n);
+    padSamples(t_, n);
+}
+
+// Keep the cars whose predicted s interval between t0 and t_end overlaps the ego's, and with lane >= 0
+// that reach into the lane then
+void ObbCollisionChecker::sweepAndPrune(double ego_s, double ego_s_lo, double ego_s_hi, double t0, double t_end,
+        const TrafficPrediction &prediction, int lane)
+{
+    std::size_t n = prediction.vehicles();
+    double reach = 0.5 * config.car_length + config.margin;
+    double half = 0.5 * config.max_s;
+    int last = prediction.steps();
+    int k0 = std::min(last, (int) (t0 / prediction.dt()));
+    int k1 = std::min(last, (int) ceil(t_end / prediction.dt()));
+    double lane_lo = lane * config.lane_width;
+    double lane_hi = lane_lo + config.lane_width;
+    double half_width = 0.5 * config.car_width + config.margin;
+
+    if (order_.size() != n)
+    {
+        order_.resize(n);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            order_[i] = (int) i;
+        }
+    }
+    s_lo_.resize(n);
+    s_hi_.resize(n);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        // past the horizon the car goes on at its predicted speed
+        double s0 = prediction.s(k0, i);
+        double s1 = prediction.s(k1, i) + std::max(0.0, t_end - k1 * prediction.dt()) * prediction.speed(i);
+        double rel = s0 - ego_s;
+        double wrap = rel > half ? -config.max_s : (rel < -half ? config.max_s : 0.0);
+        s_lo_[i] = std::min(s0, s1) + wrap - reach;
+        s_hi_[i] = std::max(s0, s1) + wrap + reach;
+
+        // the prediction moves a car straight to the lane it heads for, so both ends bound its d
+        if (lane >= 0)
+        {
+            double d_lo = std::min(prediction.d(k0, i), prediction.d(k1, i)) - half_width;
+            double d_hi = std::max(prediction.d(k0, i), prediction.d(k1, i)) + half_width;
+            if (d_hi <= lane_lo || d_lo >= lane_hi)
+            {
+                s_lo_[i] = INFINITY;
+            }
+        }
+    }
+
+    // insertion sort: the order of the cars barely changes from one frame to the next
+    for (std::size_t i = 1; i < n; i++)
+    {
+        int key = order_[i];
+        std::size_t j = i;
+        while (j > 0 && s_lo_[order_[j - 1]] > s_lo_[key])
+        {
+            order_[j] = order_[j - 1];
+            j--;
+        }
+        order_[j] = key;
+    }
+
+    candidates_.clear();
+    for (std::size_t k = 0; k < n; k++)
+    {
+        std::size_t i = order_[k];
+        if (s_lo_[i] > ego_s_hi)
+        {
+            break;
+        }
+        if (s_hi_[i] >= ego_s_lo)
+        {
+            candidates_.push_back(i);
+        }
+    }
+}
+
+// Map pose of a car at t seconds from now: its predicted (s, d) placed along the waypoints the way
+// getXY does, heading along its predicted motion
+void ObbCollisionChecker::predictedPose(const TrafficPrediction &prediction, std::size_t vehicle, double t,
+        double &x, double &y, double &heading) const
+{
+    int last = prediction.steps();
+    double f = t / prediction.dt();
+    double s, d, ds, dd;
+    if (f < last)
+    {
+        int k = (int) f;
+        double w = f - k;
+        ds = prediction.s(k + 1, vehicle) - prediction.s(k, vehicle);
+        dd = prediction.d(k + 1, vehicle) - prediction.d(k, vehicle);
+        s = prediction.s(k, vehicle) + w * ds;
+        d = prediction.d(k, vehicle) + w * dd;
+    }
+    else
+    {
+        ds = prediction.speed(vehicle) * prediction.dt();
+        dd = 0.0;
+        s = prediction.s(last, vehicle) + (f - last) * ds;
+        d = prediction.d(last, vehicle);
+    }
+    s = fmod(s, config.max_s);
+    s = s < 0.0 ? s + config.max_s : s;
+
+    const std::vector<double> &maps_s = *maps_s_;
+    const std::vector<double> &maps_x = *maps_x_;
+    const std::vector<double> &maps_y = *maps_y_;
+    int wp = (int) (std::upper_bound(maps_s.begin(), maps_s.end(), s) - maps_s.begin()) - 1;
+    wp = std::max(0, wp);
+    int wp2 = (wp + 1) % (int) maps_x.size();
+    double road = atan2(maps_y[wp2] - maps_y[wp], maps_x[wp2] - maps_x[wp]);
+    double seg_s = s - maps_s[wp];
+    // d grows to the right of the road
+    x = maps_x[wp] + seg_s * cos(road) + d * sin(road);
+    y = maps_y[wp] + seg_s * sin(road) - d * cos(road);
+    heading = road - atan2(dd, std::max(ds, 1e-6));
+}
+
+// Poses of a car at the times of the ego samples
+void ObbCollisionChecker::prepareVehicle(const TrafficPrediction &prediction, std::size_t vehicle, int n)
+{
+    std::size_t padded = cx_.size();
+    bx_.resize(padded);
+    by_.resize(padded);
+    bcos_.resize(padded);
+    bsin_.resize(padded);
+    for (int k = 0; k < n; k++)
+    {
+        double heading;
+        predictedPose(prediction, vehicle, t_[k], bx_[k], by_[k], heading);
+        bcos_[k] = cos(heading);
+        bsin_[k] = sin(heading);
+    }
+    padSamples(bx_, n);
+    padSamples(by_, n);
+    padSamples(bcos_, n);
+    padSamples(bsin_, n);
+}
+
+int ObbCollisionChecker::firstContact(int n) const
+{
+    ObbExtents e;
+    e.ha = 0.5 * config.ego_length + config.margin;
+    e.wa = 0.5 * config.ego_width + config.margin;
+    e.hb = 0.5 * config.car_length + config.margin;
+    e.wb = 0.5 * config.car_width + config.margin;
+    ObbKernel kernel = obbKernelAvailable(ObbKernel::kAvx) ? ObbKernel::kAvx : ObbKernel::kScalar;
+    return obbFirstContact(kernel, e, cx_.data(), cy_.data(), cos_.data(), sin_.data(), bx_.data(), by_.data(),
+            bcos_.data(), bsin_.data(), n);
+}
+
+bool ObbCollisionChecker::check(const double *x, const double *y, int n, double t0, double ego_s,
+        const TrafficPrediction &prediction, Collision *first, int lane)
+{
+    if (n <= 0 || prediction.vehicles() == 0 || maps_s_ == nullptr)
+    {
+        candidates_.clear();
+        return false;
+    }
+    prepareSamples(x, y, n, t0);
+
+    // s interval covered by the ego: from the first path point to the last one
+    double length = 0.0;
+    for (int k = 0; k + 1 < n; k++)
+    {
+        length += sqrt((x[k + 1] - x[k]) * (x[k + 1] - x[k]) + (y[k + 1] - y[k]) * (y[k + 1] - y[k]));
+    }
+    double ego_reach = 0.5 * config.ego_length + config.margin;
+    double ego_s_lo = ego_s - ego_reach;
+    double ego_s_hi = ego_s + ego_reach + length;
+    sweepAndPrune(ego_s, ego_s_lo, ego_s_hi, t_[0], t_[n - 1], prediction, lane);
+
+    int best_sample = -1;
+    int best_vehicle = -1;
+    // a contact at the first sample cannot be beaten, so the search stops there
+    for (std::size_t c = 0; c < candidates_.size() && best_sample != 0; c++)
+    {
+        int limit = best_sample < 0 ? n : best_sample;
+        prepareVehicle(prediction, candidates_[c], limit);
+        int k = firstContact(limit);
+        if (k >= 0 && (best_sample < 0 || k < best_sample))
+        {
+            best_sample = k;
+            best_vehicle = (int) candidates_[c];
+        }
+    }
+    if (best_sample >= 0 && first != nullptr)
+    {
+        first->sample = best_sample;
+        first->vehicle = best_vehicle;
+    }
+    return best_sample >= 0;
+}
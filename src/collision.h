@@ -0,0 +1,108 @@
+#ifndef COLLISION_H
+#define COLLISION_H
+
+#include <cstddef>
+#include <vector>
+#include "prediction.h"
+
+struct CollisionConfig
+{
+    double ego_length = 4.8;    // [m]
+    double ego_width = 2.0;     // [m]
+    double car_length = 4.8;    // [m]
+    double car_width = 2.0;     // [m]
+    double margin = 0.3;        // added to every half-extent [m]
+    double dt = 0.02;           // time between two path points [s]
+    double lane_width = 4.0;    // [m]
+    double max_s = 6945.554;    // s wraps around the track at this value
+};
+
+// First contact found by ObbCollisionChecker::check
+struct Collision
+{
+    int sample;         // index of the ego path point
+    int vehicle;        // sensor fusion row of the other car
+};
+
+// Exact collision check of an ego path against the other cars, both as oriented bounding boxes.
+// The cars follow the shared traffic prediction, mapped from Frenet to map coordinates along the
+// waypoints and oriented along their predicted motion. A sweep-and-prune broad phase over s drops
+// the cars whose predicted s interval misses the ego's; the narrow phase runs separating-axis tests
+// over four path points at a time, with an AVX kernel when the CPU supports it.
+class ObbCollisionChecker
+{
+public:
+    explicit ObbCollisionChecker(std::size_t max_vehicles = 64, int max_samples = 64);
+
+    // Waypoints the predicted cars are placed along; they have to outlive the checker
+    void setMap(const std::vector<double> &maps_s, const std::vector<double> &maps_x,
+            const std::vector<double> &maps_y);
+
+    // Check the path points x[k], y[k], k < n, visited at t0 + k * dt seconds from now. ego_s is the
+    // s of the first point. With lane >= 0 only the cars predicted to reach into that lane count.
+    // Returns true and fills *first (if given) with the earliest contact.
+    bool check(const double *x, const double *y, int n, double t0, double ego_s,
+            const TrafficPrediction &prediction, Collision *first = nullptr, int lane = -1);
+
+    CollisionConfig config;
+
+    // number of cars that reached the narrow phase in the last check
+    std::size_t narrowPhaseCount() const { return candidates_.size(); }
+
+private:
+    void prepareSamples(const double *x, const double *y, int n, double t0);
+    void sweepAndPrune(double ego_s, double ego_s_lo, double ego_s_hi, double t0, double t_end,
+            const TrafficPrediction &prediction, int lane);
+    void predictedPose(const TrafficPrediction &prediction, std::size_t vehicle, double t, double &x, double &y,
+            double &heading) const;
+    void prepareVehicle(const TrafficPrediction &prediction, std::size_t vehicle, int n);
+    int firstContact(int n) const;
+
+    const std::vector<double> *maps_s_;
+    const std::vector<double> *maps_x_;
+    const std::vector<double> *maps_y_;
+
+    // ego samples, padded to a multiple of 4
+    std::vector<double> cx_;
+    std::vector<double> cy_;
+    std::vector<double> cos_;
+    std::vector<double> sin_;
+    std::vector<double> t_;
+    // predicted poses of the car in the narrow phase at the same times
+    std::vector<double> bx_;
+    std::vector<double> by_;
+    std::vector<double> bcos_;
+    std::vector<double> bsin_;
+
+    // cars sorted by s; the order is kept between calls so re-sorting is nearly linear
+    std::vector<int> order_;
+    std::vector<double> s_lo_;
+    std::vector<double> s_hi_;
+    std::vector<std::size_t> candidates_;
+};
+
+// Box half-extents of a pair of cars
+struct ObbExtents
+{
+    double ha, wa;      // ego half length / width
+    double hb, wb;      // car half length / width
+};
+
+// The narrow-phase kernels the checker picks from at runtime, exposed so they can be compared
+enum class ObbKernel
+{
+    kScalar,
+    kAvx,
+};
+
+// Whether the kernel is compiled in and the CPU runs it
+bool obbKernelAvailable(ObbKernel kernel);
+
+// First sample k < n at which the ego box at (ax[k], ay[k]) with heading (ac[k], as[k]) overlaps the
+// car box at (bx[k], by[k]) with heading (bc[k], bs[k]), or -1. The arrays are padded to a multiple
+// of 4 samples.
+int obbFirstContact(ObbKernel kernel, const ObbExtents &extents, const double *ax, const double *ay,
+        const double *ac, const double *as, const double *bx, const double *by, const double *bc,
+        const double *bs, int n);
+
+#endif // COLLISION_H
@@ -0,0 +1,202 @@
+#include "control.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+
+const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15};
+
+// Decimal digits of n, most significant first, into buffer; returns the number of digits
+int writeDigits(std::uint64_t n, char *buffer)
+{
+    char reversed[20];
+    int count = 0;
+    do
+    {
+        reversed[count++] = (char) ('0' + n % 10);
+        n /= 10;
+    } while (n != 0);
+    for (int i = 0; i < count; i++)
+    {
+        buffer[i] = reversed[count - 1 - i];
+    }
+    return count;
+}
+
+// Fixed number of decimals without going through printf; false if the value is out of its range
+bool appendFixed(double value, int precision, std::string &out)
+{
+    if (precision > 15)
+    {
+        return false;
+    }
+    double scaled = std::fabs(value) * kPow10[precision];
+    if (!(scaled < 9e15))
+    {
+        return false;
+    }
+    std::uint64_t units = (std::uint64_t) std::llround(scaled);
+    std::uint64_t scale = (std::uint64_t) kPow10[precision];
+    std::uint64_t integer = units / scale;
+    std::uint64_t fraction = units % scale;
+
+    char buffer[40];
+    int length = 0;
+    if (value < 0.0 && units != 0)
+    {
+        buffer[length++] = '-';
+    }
+    length += writeDigits(integer, buffer + length);
+    if (fraction != 0)
+    {
+        // drop the trailing zeros of the fraction
+        int decimals = precision;
+        while (fraction % 10 == 0)
+        {
+            fraction /= 10;
+            decimals--;
+        }
+        buffer[length++] = '.';
+        char digits[20];
+        int count = writeDigits(fraction, digits);
+        for (int i = count; i < decimals; i++)
+        {
+            buffer[length++] = '0';
+        }
+        for (int i = 0; i < count; i++)
+        {
+            buffer[length++] = digits[i];
+        }
+    }
+    out.append(buffer, length);
+    return true;
+}
+
+// Fewest significant digits (15, 16 or 17) that read back to the same double
+void appendShortest(double value, std::string &out)
+{
+    char buffer[32];
+    int length = 0;
+    for (int digits = 15; digits <= 17; digits++)
+    {
+        length = snprintf(buffer, sizeof(buffer), "%.*g", digits, value);
+        if (digits == 17 || strtod(buffer, nullptr) == value)
+        {
+            break;
+        }
+    }
+    out.append(buffer, length);
+}
+
+void appendArray(const std::vector<double> &values, int precision, std::string &out)
+{
+    out.push_back('[');
+    for (std::size_t i = 0; i < values.size(); i++)
+    {
+        if (i > 0)
+        {
+            out.push_back(',');
+        }
+        appendNumber(values[i], precision, out);
+    }
+    out.push_back(']');
+}
+
+// Parse the number array that follows key in [p, end) into values
+bool parseArray(const char *p, const char *end, const char *key, std::vector<double> &values)
+{
+    values.clear();
+    std::size_t key_length = std::strlen(key);
+    const char *found = nullptr;
+    for (const char *q = p; q + key_length <= end; q++)
+    {
+        if (std::memcmp(q, key, key_length) == 0)
+        {
+            found = q + key_length;
+            break;
+        }
+    }
+    if (found == nullptr)
+    {
+        return false;
+    }
+    p = found;
+    while (p < end && *p != '[')
+    {
+        p++;
+    }
+    if (p >= end)
+    {
+        return false;
+    }
+    p++;
+    while (p < end && *p != ']')
+    {
+        if (*p == ',' || *p == ' ')
+        {
+            p++;
+            continue;
+        }
+        if (end - p >= 4 && std::memcmp(p, "null", 4) == 0)
+        {
+            values.push_back(NAN);
+            p += 4;
+            continue;
+        }
+        // numbers are followed by ',' or ']', so strtod never runs off the end of the message
+        char *next;
+        double value = std::strtod(p, &next);
+        if (next == p)
+        {
+            return false;
+        }
+        values.push_back(value);
+        p = next;
+    }
+    return p < end;
+}
+
+}  // namespace
+
+void appendNumber(double value, int precision, std::string &out)
+{
+    if (!std::isfinite(value))
+    {
+        // JSON has no representation for these
+        out.append("null");
+        return;
+    }
+    if (precision >= 0 && appendFixed(value, precision, out))
+    {
+        return;
+    }
+    appendShortest(value, out);
+}
+
+void serializeControl(const ControlFrame &control, int precision, std::string &out)
+{
+    out.clear();
+    out.append("42[\"control\",{\"next_x\":");
+    appendArray(control.next_x, precision, out);
+    out.append(",\"next_y\":");
+    appendArray(control.next_y, precision, out);
+    out.append("}]");
+}
+
+bool parseControl(const char *data, std::size_t length, ControlFrame &control)
+{
+    const char *end = data + length;
+    const char *event = "42[\"control\"";
+    std::size_t event_length = std::strlen(event);
+    if (length < event_length || std::memcmp(data, event, event_length) != 0)
+    {
+        return false;
+    }
+    return parseArray(data, end, "\"next_x\"", control.next_x) &&
+           parseArray(data, end, "\"next_y\"", control.next_y) &&
+           control.next_x.size() == control.next_y.size();
+}
@@ -0,0 +1,40 @@
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// The path sent back to the simulator: (x,y) points the car will visit sequentially every .02 seconds
+struct ControlFrame
+{
+    std::vector<double> next_x;
+    std::vector<double> next_y;
+
+    void clear()
+    {
+        next_x.clear();
+        next_y.clear();
+    }
+
+    void reserve(std::size_t points)
+    {
+        next_x.reserve(points);
+        next_y.reserve(points);
+    }
+};
+
+// Write the SocketIO frame 42["control",{"next_x":[...],"next_y":[...]}] into out, replacing its
+// contents but keeping its capacity, so a buffer reused across frames stops allocating.
+// With precision >= 0 every coordinate gets at most that many decimals (trailing zeros dropped);
+// with precision < 0 it gets the shortest representation that reads back to the same double.
+void serializeControl(const ControlFrame &control, int precision, std::string &out);
+
+// Append a single number in the format above
+void appendNumber(double value, int precision, std::string &out);
+
+// Read the path back out of a control message written by serializeControl; false if the message
+// is not a control message. Used by the tools that drive the planner without the simulator.
+bool parseControl(const char *data, std::size_t length, ControlFrame &control);
+
+#endif // CONTROL_H
@@ -0,0 +1,314 @@
+#include "diagnostics.h"
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include "stage_timer.h"
+
+namespace
+{
+
+void appendf(std::string &out, const char *format, ...)
+{
+    char buffer[256];
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buffer, sizeof(buffer), format, args);
+    va_end(args);
+    if (n > 0)
+    {
+        out.append(buffer, std::min<std::size_t>(n, sizeof(buffer) - 1));
+    }
+}
+
+void appendMetricHeader(std::string &out, const char *name, const char *type, const char *help)
+{
+    appendf(out, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+// What one session's counters are called, in Prometheus and in JSON
+struct Counter
+{
+    const char *label;
+    const std::atomic<uint64_t> SessionStats::*value;
+};
+
+const Counter kFlagCounters[] = {
+    {"ahead", &SessionStats::ahead},
+    {"left_blocked", &SessionStats::left_blocked},
+    {"right_blocked", &SessionStats::right_blocked},
+    {"emergency", &SessionStats::emergency},
+};
+
+const Counter kStateCounters[] = {
+    {"KL", &SessionStats::keep_lane},
+    {"LCL", &SessionStats::change_left},
+    {"LCR", &SessionStats::change_right},
+};
+
+void formatPrometheus(const std::vector<std::shared_ptr<const SessionStats>> &sessions, uint64_t sessions_total,
+        const std::vector<StageLatency> &stages, std::string &out)
+{
+    appendMetricHeader(out, "planner_sessions", "gauge", "Connected simulator sessions");
+    appendf(out, "planner_sessions %zu\n", sessions.size());
+    appendMetricHeader(out, "planner_sessions_total", "counter", "Simulator sessions since start");
+    appendf(out, "planner_sessions_total %llu\n", (unsigned long long) sessions_total);
+
+    appendMetricHeader(out, "planner_frames_total", "counter", "Telemetry frames planned");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_frames_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->frames.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_lane", "gauge", "Lane the planner drives in, 0 is the leftmost");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_lane{session=\"%u\"} %d\n", sessions[i]->id,
+                sessions[i]->lane.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_ref_vel_mph", "gauge", "Reference velocity of the path");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_ref_vel_mph{session=\"%u\"} %.3f\n", sessions[i]->id,
+                sessions[i]->ref_vel.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_target_vel_mph", "gauge", "Velocity of the car ahead");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_target_vel_mph{session=\"%u\"} %.3f\n", sessions[i]->id,
+                sessions[i]->target_vel.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_flags_total", "counter", "Frames with a proximity flag raised");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        for (const Counter &c : kFlagCounters)
+        {
+            appendf(out, "planner_flags_total{session=\"%u\",flag=\"%s\"} %llu\n", sessions[i]->id, c.label,
+                    (unsigned long long) ((*sessions[i]).*c.value).load(std::memory_order_relaxed));
+        }
+    }
+    appendMetricHeader(out, "planner_states_total", "counter",
+            "Next states chosen by the cost functions with a car ahead");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        for (const Counter &c : kStateCounters)
+        {
+            appendf(out, "planner_states_total{session=\"%u\",state=\"%s\"} %llu\n", sessions[i]->id, c.label,
+                    (unsigned long long) ((*sessions[i]).*c.value).load(std::memory_order_relaxed));
+        }
+    }
+    appendMetricHeader(out, "planner_lane_changes_total", "counter", "Lane changes started");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_lane_changes_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->lane_changes.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_aborted_lane_changes_total", "counter",
+            "Lane changes undone by the exact collision check");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_aborted_lane_changes_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->aborted_lane_changes.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_reused_plans_total", "counter",
+            "Frames that went on with the cached plan instead of fitting a new spline");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_reused_plans_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->reused_plans.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_candidates_total", "counter", "Candidate trajectories scored");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_candidates_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->candidates.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_skipped_candidates_total", "counter",
+            "Candidate trajectories left unscored at the deadline");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_skipped_candidates_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->skipped_candidates.load(std::memory_order_relaxed));
+    }
+    appendMetricHeader(out, "planner_deadline_misses_total", "counter",
+            "Frames whose path was not ready by the deadline");
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        appendf(out, "planner_deadline_misses_total{session=\"%u\"} %llu\n", sessions[i]->id,
+                (unsigned long long) sessions[i]->deadline_misses.load(std::memory_order_relaxed));
+    }
+
+    appendMetricHeader(out, "planner_stage_seconds", "summary", "Time spent in each stage of a planner frame");
+    for (std::size_t s = 0; s < stages.size(); s++)
+    {
+        const StageLatency &l = stages[s];
+        const char *name = stageName(l.stage);
+        appendf(out, "planner_stage_seconds{stage=\"%s\",quantile=\"0.5\"} %.9f\n", name, l.p50_us * 1e-6);
+        appendf(out, "planner_stage_seconds{stage=\"%s\",quantile=\"0.99\"} %.9f\n", name, l.p99_us * 1e-6);
+        appendf(out, "planner_stage_seconds{stage=\"%s\",quantile=\"0.999\"} %.9f\n", name, l.p999_us * 1e-6);
+        appendf(out, "planner_stage_seconds_sum{stage=\"%s\"} %.9f\n", name, l.mean_us * l.count * 1e-6);
+        appendf(out, "planner_stage_seconds_count{stage=\"%s\"} %llu\n", name, (unsigned long long) l.count);
+    }
+    appendMetricHeader(out, "planner_stage_max_seconds", "gauge", "Slowest run of each stage");
+    for (std::size_t s = 0; s < stages.size(); s++)
+    {
+        appendf(out, "planner_stage_max_seconds{stage=\"%s\"} %.9f\n", stageName(stages[s].stage),
+                stages[s].max_us * 1e-6);
+    }
+}
+
+void formatJson(const std::vector<std::shared_ptr<const SessionStats>> &sessions, uint64_t sessions_total,
+        const std::vector<StageLatency> &stages, std::string &out)
+{
+    appendf(out, "{\"sessions_total\":%llu,\"sessions\":[", (unsigned long long) sessions_total);
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        const SessionStats &s = *sessions[i];
+        appendf(out, "%s{\"id\":%u,\"frames\":%llu,\"lane\":%d,\"ref_vel\":%.3f,\"target_vel\":%.3f",
+                i > 0 ? "," : "", s.id, (unsigned long long) s.frames.load(std::memory_order_relaxed),
+                s.lane.load(std::memory_order_relaxed), s.ref_vel.load(std::memory_order_relaxed),
+                s.target_vel.load(std::memory_order_relaxed));
+        const char *separator = ",\"flags\":{";
+        for (const Counter &c : kFlagCounters)
+        {
+            appendf(out, "%s\"%s\":%llu", separator, c.label,
+                    (unsigned long long) (s.*c.value).load(std::memory_order_relaxed));
+            separator = ",";
+        }
+        separator = "},\"states\":{";
+        for (const Counter &c : kStateCounters)
+        {
+            appendf(out, "%s\"%s\":%llu", separator, c.label,
+                    (unsigned long long) (s.*c.value).load(std::memory_order_relaxed));
+            separator = ",";
+        }
+        appendf(out, "},\"lane_changes\":%llu,\"aborted_lane_changes\":%llu,\"reused_plans\":%llu",
+                (unsigned long long) s.lane_changes.load(std::memory_order_relaxed),
+                (unsigned long long) s.aborted_lane_changes.load(std::memory_order_relaxed),
+                (unsigned long long) s.reused_plans.load(std::memory_order_relaxed));
+        appendf(out, ",\"candidates\":%llu,\"skipped_candidates\":%llu,\"deadline_misses\":%llu}",
+                (unsigned long long) s.candidates.load(std::memory_order_relaxed),
+                (unsigned long long) s.skipped_candidates.load(std::memory_order_relaxed),
+                (unsigned long long) s.deadline_misses.load(std::memory_order_relaxed));
+    }
+    out += "],\"stages\":{";
+    for (std::size_t s = 0; s < stages.size(); s++)
+    {
+        const StageLatency &l = stages[s];
+        appendf(out, "%s\"%s\":{\"count\":%llu,\"mean_us\":%.3f,\"p50_us\":%.3f,\"p99_us\":%.3f,"
+                "\"p999_us\":%.3f,\"max_us\":%.3f}", s > 0 ? "," : "", stageName(l.stage),
+                (unsigned long long) l.count, l.mean_us, l.p50_us, l.p99_us, l.p999_us, l.max_us);
+    }
+    out += "}}\n";
+}
+
+}  // namespace
+
+void SessionStats::publish(const PlannerContext &ctx)
+{
+    const PlannerCounters &c = ctx.counters;
+    frames.store(ctx.frame, std::memory_order_relaxed);
+    lane.store(ctx.lane, std::memory_order_relaxed);
+    ref_vel.store(ctx.ref_vel, std::memory_order_relaxed);
+    target_vel.store(ctx.target_vel, std::memory_order_relaxed);
+    ahead.store(c.ahead, std::memory_order_relaxed);
+    left_blocked.store(c.left_blocked, std::memory_order_relaxed);
+    right_blocked.store(c.right_blocked, std::memory_order_relaxed);
+    emergency.store(c.emergency, std::memory_order_relaxed);
+    keep_lane.store(c.keep_lane, std::memory_order_relaxed);
+    change_left.store(c.change_left, std::memory_order_relaxed);
+    change_right.store(c.change_right, std::memory_order_relaxed);
+    lane_changes.store(c.lane_changes, std::memory_order_relaxed);
+    aborted_lane_changes.store(c.aborted_lane_changes, std::memory_order_relaxed);
+    reused_plans.store(c.reused_plans, std::memory_order_relaxed);
+    candidates.store(c.candidates, std::memory_order_relaxed);
+    skipped_candidates.store(c.skipped_candidates, std::memory_order_relaxed);
+    deadline_misses.store(c.deadline_misses, std::memory_order_relaxed);
+}
+
+DiagnosticsBoard::DiagnosticsBoard(std::chrono::milliseconds interval)
+    : interval_(interval), snapshot_(std::make_shared<DiagnosticsSnapshot>())
+{
+}
+
+DiagnosticsBoard::~DiagnosticsBoard()
+{
+    stop();
+}
+
+void DiagnosticsBoard::start()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (running_)
+    {
+        return;
+    }
+    running_ = true;
+    thread_ = std::thread([this]() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (running_)
+        {
+            lock.unlock();
+            refresh();
+            lock.lock();
+            wake_.wait_for(lock, interval_, [this]() { return !running_; });
+        }
+    });
+}
+
+void DiagnosticsBoard::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    wake_.notify_all();
+    if (thread_.joinable())
+    {
+        thread_.join();
+    }
+}
+
+void DiagnosticsBoard::attach(const std::shared_ptr<const SessionStats> &stats)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    sessions_.push_back(stats);
+    sessions_total_++;
+}
+
+void DiagnosticsBoard::detach(const SessionStats *stats)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (std::size_t i = 0; i < sessions_.size(); i++)
+    {
+        if (sessions_[i].get() == stats)
+        {
+            sessions_.erase(sessions_.begin() + i);
+            return;
+        }
+    }
+}
+
+std::shared_ptr<const DiagnosticsSnapshot> DiagnosticsBoard::snapshot() const
+{
+    return std::atomic_load(&snapshot_);
+}
+
+void DiagnosticsBoard::refresh()
+{
+    std::vector<std::shared_ptr<const SessionStats>> sessions;
+    uint64_t sessions_total;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        sessions = sessions_;
+        sessions_total = sessions_total_;
+    }
+    std::vector<StageLatency> stages;
+    stageLatencies(stages);
+
+    std::shared_ptr<DiagnosticsSnapshot> snapshot = std::make_shared<DiagnosticsSnapshot>();
+    snapshot->prometheus.reserve(4096 + 2048 * sessions.size());
+    snapshot->json.reserve(2048 + 512 * sessions.size());
+    formatPrometheus(sessions, sessions_total, stages, snapshot->prometheus);
+    formatJson(sessions, sessions_total, stages, snapshot->json);
+    std::atomic_store(&snapshot_, std::shared_ptr<const DiagnosticsSnapshot>(snapshot));
+}
@@ -0,0 +1,85 @@
+#ifndef DIAGNOSTICS_H
+#define DIAGNOSTICS_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "planner.h"
+
+// The live state of one session. The thread planning the session publishes into it after every
+// frame with relaxed stores; the diagnostics thread reads it whenever it likes. Values of one read
+// may come from neighbouring frames, which is fine for monitoring.
+class SessionStats
+{
+public:
+    explicit SessionStats(uint32_t id) : id(id) {}
+
+    void publish(const PlannerContext &ctx);
+
+    const uint32_t id;
+    std::atomic<uint64_t> frames{0};
+    std::atomic<int> lane{1};
+    std::atomic<double> ref_vel{0.0};
+    std::atomic<double> target_vel{0.0};
+    std::atomic<uint64_t> ahead{0};
+    std::atomic<uint64_t> left_blocked{0};
+    std::atomic<uint64_t> right_blocked{0};
+    std::atomic<uint64_t> emergency{0};
+    std::atomic<uint64_t> keep_lane{0};
+    std::atomic<uint64_t> change_left{0};
+    std::atomic<uint64_t> change_right{0};
+    std::atomic<uint64_t> lane_changes{0};
+    std::atomic<uint64_t> aborted_lane_changes{0};
+    std::atomic<uint64_t> reused_plans{0};
+    std::atomic<uint64_t> candidates{0};
+    std::atomic<uint64_t> skipped_candidates{0};
+    std::atomic<uint64_t> deadline_misses{0};
+};
+
+// The diagnostics as served, formatted ahead of time
+struct DiagnosticsSnapshot
+{
+    std::string prometheus;
+    std::string json;
+};
+
+// Collects the stats of every connected session and the stage latencies, and formats them on its
+// own thread every interval into a Prometheus text page and a JSON document. HTTP handlers only
+// pick up the latest snapshot, so scraping neither formats anything nor touches planner state.
+class DiagnosticsBoard
+{
+public:
+    explicit DiagnosticsBoard(std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+    ~DiagnosticsBoard();
+
+    void start();
+    void stop();
+
+    // Called by the event loops when a client connects or goes away
+    void attach(const std::shared_ptr<const SessionStats> &stats);
+    void detach(const SessionStats *stats);
+
+    // The latest snapshot; never null
+    std::shared_ptr<const DiagnosticsSnapshot> snapshot() const;
+
+    // Format a new snapshot now
+    void refresh();
+
+private:
+    std::chrono::milliseconds interval_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool running_ = false;
+    std::thread thread_;
+    std::vector<std::shared_ptr<const SessionStats>> sessions_;
+    uint64_t sessions_total_ = 0;
+    std::shared_ptr<const DiagnosticsSnapshot> snapshot_;
+};
+
+#endif // DIAGNOSTICS_H
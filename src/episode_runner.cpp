@@ -0,0 +1,132 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "episodes.h"
+#include "planner.h"
+#include "scheduler.h"
+
+// Monte-Carlo robustness runs: many independent closed-loop episodes of the planner against the
+// headless simulator, with different seeds and traffic densities, spread over all cores.
+// --max-incidents and --max-comfort bound the incidents and comfort violations per 100 miles over
+// all episodes; the run exits with 2 if it goes over either.
+//
+//   episode_runner [--episodes 16] [--densities 6,12,24] [--miles 5] [--seed 1] [--points 3]
+//                  [--max-incidents R] [--max-comfort R] [--threads 0] [--map ../data/highway_map.csv]
+
+int main(int argc, char *argv[])
+{
+    std::string map_file = "../data/highway_map.csv";
+    int episodes = 16;
+    std::vector<int> densities = {6, 12, 24};
+    EpisodeSpec base;
+    // per 100 miles, negative for no bound
+    double max_incidents = -1.0;
+    double max_comfort = -1.0;
+    unsigned threads = 0;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--episodes")
+        {
+            episodes = atoi(argv[++i]);
+        }
+        else if (arg == "--densities")
+        {
+            densities.clear();
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ','))
+            {
+                densities.push_back(atoi(item.c_str()));
+            }
+        }
+        else if (arg == "--miles")
+        {
+            base.miles = atof(argv[++i]);
+        }
+        else if (arg == "--seed")
+        {
+            base.seed = (unsigned) atoi(argv[++i]);
+        }
+        else if (arg == "--points")
+        {
+            base.points_per_step = atoi(argv[++i]);
+        }
+        else if (arg == "--threads")
+        {
+            threads = (unsigned) atoi(argv[++i]);
+        }
+        else if (arg == "--max-incidents")
+        {
+            max_incidents = atof(argv[++i]);
+        }
+        else if (arg == "--max-comfort")
+        {
+            max_comfort = atof(argv[++i]);
+        }
+        else if (arg == "--map")
+        {
+            map_file = argv[++i];
+        }
+    }
+
+    HighwayMap map;
+    if (!loadHighwayMap(map_file, map))
+    {
+        std::cerr << "Failed to load the map " << map_file << std::endl;
+        return 1;
+    }
+
+    std::vector<EpisodeSpec> specs;
+    for (std::size_t d = 0; d < densities.size(); d++)
+    {
+        for (int e = 0; e < episodes; e++)
+        {
+            EpisodeSpec spec = base;
+            spec.cars = densities[d];
+            spec.seed = base.seed + e;
+            specs.push_back(spec);
+        }
+    }
+
+    TaskScheduler scheduler(threads);
+    std::vector<EpisodeResult> results;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    runEpisodes(map, specs, scheduler, results);
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    printEpisodeReport(results, std::cout);
+    double hours = 0.0;
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        hours += results[i].metrics.time / 3600.0;
+    }
+    std::cout << specs.size() << " episodes on " << scheduler.threads() << " threads in " << wall
+              << " s (" << hours * 3600.0 / wall << "x real time, " << scheduler.steals() << " steals)"
+              << std::endl;
+
+    std::vector<const EpisodeResult *> all;
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        all.push_back(&results[i]);
+    }
+    EpisodeSummary total = summarizeEpisodes(all);
+    double per_100_miles = total.miles > 0 ? 100.0 / total.miles : 0.0;
+    double incident_rate = per_100_miles * total.incidents;
+    double comfort_rate = per_100_miles * total.comfort_violations;
+    bool failed = false;
+    if (max_incidents >= 0 && incident_rate > max_incidents)
+    {
+        std::cout << incident_rate << " incidents per 100 miles, more than " << max_incidents << std::endl;
+        failed = true;
+    }
+    if (max_comfort >= 0 && comfort_rate > max_comfort)
+    {
+        std::cout << comfort_rate << " comfort violations per 100 miles, more than " << max_comfort << std::endl;
+        failed = true;
+    }
+    return failed ? 2 : 0;
+}
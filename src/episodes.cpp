@@ -0,0 +1,153 @@
+#include "episodes.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <string>
+
+namespace
+{
+
+// q-quantile of sorted values, nearest rank
+double percentile(const std::vector<float> &sorted, double q)
+{
+    if (sorted.empty())
+    {
+        return 0.0;
+    }
+    std::size_t rank = (std::size_t) (q * (sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+void printSummary(const char *label, const EpisodeSummary &s, std::ostream &out)
+{
+    char line[256];
+    snprintf(line, sizeof(line),
+            "%-8s %8d %9.1f %9d %7d %6d/%-6d %8.2f %8.2f %7.2f %7.2f %6.1f %8.1f %8.1f %8.1f %5d\n",
+            label, s.episodes, s.miles, s.incidents, s.comfort_violations, s.clean_episodes, s.episodes,
+            s.mean_miles_without_incident, s.min_miles_without_incident, s.mean_max_jerk, s.max_jerk,
+            s.mean_speed, s.latency_p50, s.latency_p99, s.latency_p999, s.stuck);
+    out << line;
+}
+
+}  // namespace
+
+void runEpisode(const HighwayMap &map, const EpisodeSpec &spec, EpisodeResult &result)
+{
+    SimulatorConfig config;
+    config.cars = spec.cars;
+    config.seed = spec.seed;
+    config.points_per_step = spec.points_per_step;
+    HighwaySimulator simulator(map, config);
+    Planner planner(map);
+    planner.context().params = spec.params;
+    std::string message;
+    std::string reply;
+    message.reserve(8192);
+    reply.reserve(4096);
+
+    const double metres = spec.miles * 1609.344;
+    const double max_time = metres / (5.0 / 2.24);
+    result.spec = spec;
+    result.latency_us.clear();
+    result.latency_us.reserve((std::size_t) (metres / 0.02 / 20.0 / std::max(1, spec.points_per_step)) + 1024);
+    while (simulator.metrics().distance < metres && simulator.metrics().time < max_time)
+    {
+        simulator.telemetry(message);
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool answered = planner.handleMessage(message.data(), message.size(), reply);
+        result.latency_us.push_back(
+                std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count());
+        if (!answered || !simulator.advance(reply.data(), reply.size()))
+        {
+            break;
+        }
+    }
+    result.metrics = simulator.metrics();
+    result.stuck = result.metrics.distance < metres;
+}
+
+void runEpisodes(const HighwayMap &map, const std::vector<EpisodeSpec> &specs, TaskScheduler &scheduler,
+        std::vector<EpisodeResult> &results)
+{
+    results.resize(specs.size());
+    for (std::size_t i = 0; i < specs.size(); i++)
+    {
+        const EpisodeSpec *spec = &specs[i];
+        EpisodeResult *result = &results[i];
+        scheduler.submit([&map, spec, result] { runEpisode(map, *spec, *result); });
+    }
+    scheduler.wait();
+}
+
+EpisodeSummary summarizeEpisodes(const std::vector<const EpisodeResult *> &results)
+{
+    EpisodeSummary s;
+    if (results.empty())
+    {
+        return s;
+    }
+    std::vector<float> latencies;
+    double distance = 0.0;
+    double min_clean = INFINITY;
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        const SimulatorMetrics &m = results[i]->metrics;
+        s.episodes++;
+        s.clean_episodes += m.incidents() == 0 ? 1 : 0;
+        s.incidents += m.incidents();
+        s.comfort_violations += m.comfortViolations();
+        s.collisions += m.collisions;
+        s.off_lane_seconds += m.off_lane_time;
+        s.stuck += results[i]->stuck ? 1 : 0;
+        s.hours += m.time / 3600.0;
+        distance += m.distance;
+        double clean = m.distanceWithoutIncident() / 1609.344;
+        s.mean_miles_without_incident += clean;
+        min_clean = std::min(min_clean, clean);
+        s.mean_max_jerk += m.max_jerk;
+        s.max_jerk = std::max(s.max_jerk, m.max_jerk);
+        latencies.insert(latencies.end(), results[i]->latency_us.begin(), results[i]->latency_us.end());
+    }
+    s.miles = distance / 1609.344;
+    s.mean_miles_without_incident /= s.episodes;
+    s.min_miles_without_incident = min_clean;
+    s.mean_max_jerk /= s.episodes;
+    s.mean_speed = s.hours > 0 ? s.miles / s.hours : 0.0;
+
+    std::sort(latencies.begin(), latencies.end());
+    s.latency_p50 = percentile(latencies, 0.5);
+    s.latency_p99 = percentile(latencies, 0.99);
+    s.latency_p999 = percentile(latencies, 0.999);
+    s.latency_max = latencies.empty() ? 0.0 : latencies.back();
+    return s;
+}
+
+void printEpisodeReport(const std::vector<EpisodeResult> &results, std::ostream &out)
+{
+    std::map<int, std::vector<const EpisodeResult *>> by_density;
+    std::vector<const EpisodeResult *> all;
+    for (std::size_t i = 0; i < results.size(); i++)
+    {
+        by_density[results[i].spec.cars].push_back(&results[i]);
+        all.push_back(&results[i]);
+    }
+
+    char header[512];
+    snprintf(header, sizeof(header),
+            "%-8s %8s %9s %9s %7s %13s %17s %15s %6s %26s %5s\n"
+            "%-8s %8s %9s %9s %7s %13s %8s %8s %7s %7s %6s %8s %8s %8s %5s\n",
+            "cars", "episodes", "miles", "incidents", "comfort", "clean", "mi w/o incident", "max jerk", "mean",
+            "planner latency us", "stuck",
+            "", "", "", "", "", "", "mean", "min", "mean", "max", "mph", "p50", "p99", "p99.9", "");
+    out << header;
+    for (std::map<int, std::vector<const EpisodeResult *>>::const_iterator it = by_density.begin();
+         it != by_density.end(); ++it)
+    {
+        printSummary(std::to_string(it->first).c_str(), summarizeEpisodes(it->second), out);
+    }
+    EpisodeSummary total = summarizeEpisodes(all);
+    printSummary("all", total, out);
+    out << "collisions: " << total.collisions << ", simulated hours: " << total.hours
+        << ", slowest planner call: " << total.latency_max << " us\n";
+}
@@ -0,0 +1,69 @@
+#ifndef EPISODES_H
+#define EPISODES_H
+
+#include <ostream>
+#include <vector>
+#include "planner.h"
+#include "scheduler.h"
+#include "simulator.h"
+
+// One closed-loop run of the planner against the headless simulator
+struct EpisodeSpec
+{
+    unsigned seed = 1;
+    // traffic density: other cars around the ego car
+    int cars = 12;
+    double miles = 5.0;
+    int points_per_step = 3;
+    // planner constants to run with
+    PlannerParams params;
+};
+
+struct EpisodeResult
+{
+    EpisodeSpec spec;
+    SimulatorMetrics metrics;
+    // wall time of every planner call, in microseconds
+    std::vector<float> latency_us;
+    // the run hit its time limit before covering its miles, e.g. because the car got stuck
+    bool stuck = false;
+};
+
+// What a set of episodes adds up to
+struct EpisodeSummary
+{
+    int episodes = 0;
+    int clean_episodes = 0;     // without any incident
+    int incidents = 0;
+    // acceleration and jerk over the limits, which do not count as incidents
+    int comfort_violations = 0;
+    int collisions = 0;
+    double off_lane_seconds = 0.0;
+    double miles = 0.0;
+    double hours = 0.0;         // simulated
+    int stuck = 0;
+    double mean_miles_without_incident = 0.0;
+    double min_miles_without_incident = 0.0;
+    double mean_max_jerk = 0.0;
+    double max_jerk = 0.0;
+    double mean_speed = 0.0;    // mph, over all the simulated time
+    // planner call latency over every frame of every episode, in microseconds
+    double latency_p50 = 0.0;
+    double latency_p99 = 0.0;
+    double latency_p999 = 0.0;
+    double latency_max = 0.0;
+};
+
+// Drive one episode to its distance or, if the car averages below 5 mph, its time limit
+void runEpisode(const HighwayMap &map, const EpisodeSpec &spec, EpisodeResult &result);
+
+// Run every episode as its own task on the scheduler; results line up with specs
+void runEpisodes(const HighwayMap &map, const std::vector<EpisodeSpec> &specs, TaskScheduler &scheduler,
+        std::vector<EpisodeResult> &results);
+
+EpisodeSummary summarizeEpisodes(const std::vector<const EpisodeResult *> &results);
+
+// One line per traffic density and one for all episodes together
+void printEpisodeReport(const std::vector<EpisodeResult> &results, std::ostream &out);
+
+#endif // EPISODES_H
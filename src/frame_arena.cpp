@@ -0,0 +1,62 @@
+#include "frame_arena.h"
+#include <algorithm>
+#include <new>
+
+FrameArena::FrameArena(std::size_t capacity)
+    : block_(static_cast<char *>(::operator new(capacity))), capacity_(capacity)
+{
+}
+
+FrameArena::~FrameArena()
+{
+    for (void *p : overflow_)
+    {
+        ::operator delete(p);
+    }
+    ::operator delete(block_);
+}
+
+void *FrameArena::allocate(std::size_t bytes, std::size_t alignment)
+{
+    // the block comes from operator new, so it is aligned for any fundamental type
+    std::size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+    if (offset + bytes <= capacity_)
+    {
+        used_ = offset + bytes;
+        peak_ = std::max(peak_, used());
+        return block_ + offset;
+    }
+
+    void *p = ::operator new(bytes);
+    overflow_.push_back(p);
+    overflow_bytes_ += bytes;
+    overflows_++;
+    peak_ = std::max(peak_, used());
+    return p;
+}
+
+void FrameArena::rewind(std::size_t mark)
+{
+    used_ = mark;
+    if (used_ > 0 || overflow_.empty())
+    {
+        return;
+    }
+
+    // the last frame did not fit: grow the block so that the next one does
+    for (void *p : overflow_)
+    {
+        ::operator delete(p);
+    }
+    ::operator delete(block_);
+    capacity_ = std::max(2 * capacity_, capacity_ + overflow_bytes_);
+    block_ = static_cast<char *>(::operator new(capacity_));
+    overflow_.clear();
+    overflow_bytes_ = 0;
+}
+
+FrameArena &FrameArena::local()
+{
+    thread_local FrameArena arena;
+    return arena;
+}
@@ -0,0 +1,92 @@
+#ifndef FRAME_ARENA_H
+#define FRAME_ARENA_H
+
+#include <cstddef>
+#include <vector>
+
+// Monotonic arena for the temporaries of one planner frame. Allocating bumps a pointer and freeing
+// does nothing; the memory comes back all at once when the ArenaScope that took it ends. If a frame
+// needs more than the block holds, the rest comes from the heap, and once the arena is empty again
+// the block grows to fit, so steady-state frames never call into the global heap.
+class FrameArena
+{
+public:
+    explicit FrameArena(std::size_t capacity = 16 << 10);
+    ~FrameArena();
+
+    FrameArena(const FrameArena &) = delete;
+    FrameArena &operator=(const FrameArena &) = delete;
+
+    void *allocate(std::size_t bytes, std::size_t alignment);
+
+    // Bytes of the block, in use right now, and at most since the arena was created
+    std::size_t capacity() const { return capacity_; }
+    std::size_t used() const { return used_ + overflow_bytes_; }
+    std::size_t peak() const { return peak_; }
+    // Allocations that did not fit into the block and went to the heap
+    std::size_t overflows() const { return overflows_; }
+
+    // The arena of the calling thread
+    static FrameArena &local();
+
+private:
+    friend class ArenaScope;
+
+    // Give back everything allocated after the given offset into the block
+    void rewind(std::size_t mark);
+
+    char *block_;
+    std::size_t capacity_;
+    std::size_t used_ = 0;
+    std::size_t peak_ = 0;
+    std::size_t overflows_ = 0;
+    // Allocations that did not fit, freed when the arena is empty again
+    std::vector<void *> overflow_;
+    std::size_t overflow_bytes_ = 0;
+};
+
+// Everything allocated from the arena while the scope is alive is given back when it ends. Scopes
+// nest; containers using the arena have to be destroyed before the scope they were created in.
+class ArenaScope
+{
+public:
+    explicit ArenaScope(FrameArena &arena) : arena_(arena), mark_(arena.used_) {}
+    ~ArenaScope() { arena_.rewind(mark_); }
+
+    ArenaScope(const ArenaScope &) = delete;
+    ArenaScope &operator=(const ArenaScope &) = delete;
+
+private:
+    FrameArena &arena_;
+    std::size_t mark_;
+};
+
+// Standard allocator drawing from a FrameArena, for containers that live within one frame
+template <class T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(FrameArena &arena) : arena_(&arena) {}
+    template <class U>
+    ArenaAllocator(const ArenaAllocator<U> &other) : arena_(other.arena()) {}
+
+    T *allocate(std::size_t n) { return static_cast<T *>(arena_->allocate(n * sizeof(T), alignof(T))); }
+    void deallocate(T *, std::size_t) {}
+
+    FrameArena *arena() const { return arena_; }
+
+private:
+    FrameArena *arena_;
+};
+
+template <class T, class U>
+bool operator==(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() == b.arena(); }
+template <class T, class U>
+bool operator!=(const ArenaAllocator<T> &a, const ArenaAllocator<U> &b) { return a.arena() != b.arena(); }
+
+template <class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T>>;
+
+#endif // FRAME_ARENA_H
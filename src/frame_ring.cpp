@@ -0,0 +1,126 @@
+#include <atomic>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "pipeline.h"
+
+// Stress test of the lock-free FrameRing: one thread publishes numbered frames as fast as it can
+// while another takes them. Every frame taken has to be whole, newer than the one before, and the
+// last frame published has to be the one the consumer ends up with; frames taken plus frames
+// dropped add up to frames published. Build with -DPLANNER_TSAN=ON to run it under ThreadSanitizer.
+// Exits with 1 on the first violation.
+//
+//   frame_ring [--frames 1000000]
+
+namespace
+{
+
+// Frame number n, followed by a body whose length and contents depend on n, so a frame mixed from
+// two writes shows
+void writeFrame(unsigned long n, std::string &frame)
+{
+    frame = std::to_string(n);
+    frame += ':';
+    frame.append(n % 512, (char) ('a' + n % 26));
+}
+
+// The number of a whole frame, or 0 if it is torn
+unsigned long readFrame(const std::string &frame)
+{
+    std::size_t colon = frame.find(':');
+    if (colon == std::string::npos)
+    {
+        return 0;
+    }
+    unsigned long n = strtoul(frame.c_str(), nullptr, 10);
+    if (frame.length() - colon - 1 != n % 512 ||
+        frame.find_first_not_of((char) ('a' + n % 26), colon + 1) != std::string::npos)
+    {
+        return 0;
+    }
+    return n;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    unsigned long frames = 1000000;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--frames")
+        {
+            frames = strtoul(argv[++i], nullptr, 10);
+        }
+    }
+
+    FrameRing ring(1024);
+    std::atomic<bool> done(false);
+    std::thread producer([&ring, &done, frames]() {
+        for (unsigned long n = 1; n <= frames; n++)
+        {
+            writeFrame(n, ring.back());
+            ring.publish();
+            // let the consumer in now and then, so the two interleave on a single core too
+            if (n % 16 == 0)
+            {
+                std::this_thread::yield();
+            }
+        }
+        done.store(true, std::memory_order_release);
+    });
+
+    unsigned long last = 0;
+    unsigned long taken = 0;
+    bool failed = false;
+    while (!failed)
+    {
+        // read done before taking, so the last take sees every frame published
+        bool finished = done.load(std::memory_order_acquire);
+        if (ring.take())
+        {
+            unsigned long n = readFrame(ring.front());
+            if (n == 0)
+            {
+                std::cerr << "frame after " << last << " is torn" << std::endl;
+                failed = true;
+            }
+            else if (n <= last)
+            {
+                std::cerr << "frame " << n << " taken after frame " << last << std::endl;
+                failed = true;
+            }
+            last = n;
+            taken++;
+        }
+        else if (finished)
+        {
+            break;
+        }
+        else
+        {
+            std::this_thread::yield();
+        }
+    }
+    producer.join();
+    if (failed)
+    {
+        return 1;
+    }
+    if (last != frames)
+    {
+        std::cerr << "the newest frame is " << frames << ", but the consumer ended with " << last << std::endl;
+        return 1;
+    }
+    if (taken + ring.dropped() != frames)
+    {
+        std::cerr << taken << " frames taken and " << ring.dropped() << " dropped, but " << frames
+                  << " published" << std::endl;
+        return 1;
+    }
+    std::cout << frames << " frames published, " << taken << " taken in order, " << ring.dropped()
+              << " overwritten" << std::endl;
+    return 0;
+}
@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include "planner.h"
+#include "recorder.h"
+#include "simulator.h"
+#include "stage_timer.h"
+
+// Drives the planner in-process against the headless highway simulator, much faster than real
+// time, and reports how far it got and what went wrong on the way.
+//
+//   highway_sim [--miles 100] [--cars 12] [--seed 1] [--points 3] [--record FILE] [--reuse-plan 0]
+//               [--deadline-us 0] [--lookahead 0] [--beam 6] [--map ../data/highway_map.csv]
+//
+// --lookahead N picks the next state by a beam search over N maneuvers, keeping --beam sequences.
+//
+// --record logs every frame and reply like the server does, e.g. to replay them later as a benchmark
+// or as the training run of a profile-guided build.
+//
+// Exits with 2 if the run had an incident or a comfort violation.
+
+int main(int argc, char *argv[])
+{
+    std::string map_file = "../data/highway_map.csv";
+    double miles = 100.0;
+    SimulatorConfig config;
+    std::string log_file;
+    bool reuse_plan = false;
+    long deadline_us = 0;
+    int lookahead = 0;
+    int beam = BehaviorConfig().beam_width;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            break;
+        }
+        if (arg == "--miles")
+        {
+            miles = atof(argv[++i]);
+        }
+        else if (arg == "--cars")
+        {
+            config.cars = atoi(argv[++i]);
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = (unsigned) atoi(argv[++i]);
+        }
+        else if (arg == "--points")
+        {
+            config.points_per_step = atoi(argv[++i]);
+        }
+        else if (arg == "--record")
+        {
+            log_file = argv[++i];
+        }
+        else if (arg == "--reuse-plan")
+        {
+            reuse_plan = atoi(argv[++i]) != 0;
+        }
+        else if (arg == "--deadline-us")
+        {
+            deadline_us = std::max(0L, atol(argv[++i]));
+        }
+        else if (arg == "--lookahead")
+        {
+            lookahead = atoi(argv[++i]);
+        }
+        else if (arg == "--beam")
+        {
+            beam = atoi(argv[++i]);
+        }
+        else if (arg == "--map")
+        {
+            map_file = argv[++i];
+        }
+    }
+
+    // large enough that the writer thread keeps up with the simulator without dropping records
+    TelemetryRecorder recorder(64 << 20);
+    if (!log_file.empty() && !recorder.open(log_file))
+    {
+        std::cerr << "Failed to open the log " << log_file << std::endl;
+        return 1;
+    }
+
+    HighwayMap map;
+    if (!loadHighwayMap(map_file, map))
+    {
+        std::cerr << "Failed to load the map " << map_file << std::endl;
+        return 1;
+    }
+
+    HighwaySimulator simulator(map, config);
+    Planner planner(map);
+    planner.context().reuse_plan = reuse_plan;
+    planner.context().deadline = std::chrono::microseconds(deadline_us);
+    planner.context().lookahead = lookahead > 0;
+    planner.context().behavior.config.depth = lookahead;
+    planner.context().behavior.config.beam_width = beam;
+    std::string message;
+    std::string reply;
+    message.reserve(8192);
+    reply.reserve(4096);
+
+    // give up if the car averages less than 5 mph, e.g. when it got stuck
+    const double metres = miles * 1609.344;
+    const double max_time = metres / (5.0 / 2.24);
+
+    double planning_seconds = 0.0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    while (simulator.metrics().distance < metres && simulator.metrics().time < max_time)
+    {
+        simulator.telemetry(message);
+        std::chrono::steady_clock::time_point plan_start = std::chrono::steady_clock::now();
+        bool answered = planner.handleMessage(message.data(), message.size(), reply);
+        planning_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - plan_start).count();
+        if (recorder.isOpen())
+        {
+            recorder.record(RecordType::kTelemetry, 0, message.data(), message.size());
+            if (answered)
+            {
+                recorder.record(RecordType::kControl, 0, reply.data(), reply.size());
+            }
+        }
+        if (!answered || !simulator.advance(reply.data(), reply.size()))
+        {
+            std::cerr << "The planner did not answer with a path" << std::endl;
+            return 1;
+        }
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    recorder.close();
+    if (recorder.dropped() > 0)
+    {
+        std::cerr << recorder.dropped() << " records did not fit into the log buffer" << std::endl;
+    }
+
+    const SimulatorMetrics &m = simulator.metrics();
+    std::cout << "simulated miles:          " << m.distance / 1609.344 << std::endl;
+    std::cout << "simulated time:           " << m.time << " s" << std::endl;
+    std::cout << "wall time:                " << wall << " s (planner " << planning_seconds << " s)" << std::endl;
+    std::cout << "miles per wall hour:      " << (m.distance / 1609.344) / (wall / 3600.0) << std::endl;
+    std::cout << "faster than real time:    " << m.time / wall << "x" << std::endl;
+    std::cout << "mean planner call:        " << 1e6 * planning_seconds / m.steps << " us" << std::endl;
+    std::cout << "mean speed:               " << m.meanSpeed() * 2.24 << " mph" << std::endl;
+    std::cout << "max speed:                " << m.max_speed << " mph" << std::endl;
+    std::cout << "max acceleration:         " << m.max_accel << " m/s^2" << std::endl;
+    std::cout << "max jerk:                 " << m.max_jerk << " m/s^3" << std::endl;
+    std::cout << "lane changes:             " << planner.context().counters.lane_changes << " ("
+              << planner.context().counters.aborted_lane_changes << " turned back)" << std::endl;
+    std::cout << "reused plans:             " << planner.context().counters.reused_plans << " of " << m.steps
+              << " frames" << std::endl;
+    const PlannerCounters &counters = planner.context().counters;
+    std::cout << "candidates scored:        " << counters.candidates << " (" << counters.skipped_candidates
+              << " skipped)" << std::endl;
+    std::cout << "deadline misses:          " << counters.deadline_misses << std::endl;
+    std::cout << "lookahead rollouts:       " << counters.lookahead_rollouts << " (" << counters.lookahead_cache_hits
+              << " cached)" << std::endl;
+    std::cout << "miles without incident:   " << m.distanceWithoutIncident() / 1609.344 << std::endl;
+    std::cout << "incidents:                " << m.incidents() << std::endl;
+    std::cout << "  collisions:             " << m.collisions << std::endl;
+    std::cout << "  speed limit:            " << m.speed_violations << std::endl;
+    std::cout << "  out of lane:            " << m.lane_violations << std::endl;
+    std::cout << "comfort violations:       " << m.comfortViolations() << std::endl;
+    std::cout << "  acceleration:           " << m.accel_violations << std::endl;
+    std::cout << "  jerk:                   " << m.jerk_violations << std::endl;
+    printStageReport(std::cout);
+    return m.incidents() == 0 && m.comfortViolations() == 0 ? 0 : 2;
+}
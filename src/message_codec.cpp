@@ -0,0 +1,177 @@
+#include <math.h>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "control.h"
+#include "json.hpp"
+#include "recorder.h"
+#include "telemetry.h"
+
+// Checks the hand-written message codec against json.hpp, which parsed and wrote the messages before:
+// every telemetry and control message of the given logs is parsed both ways and compared field by
+// field, and every control path is written back at precision 6 and -1 and read again. Exits with 1
+// on the first difference.
+//
+//   message_codec LOG...
+
+using json = nlohmann::json;
+
+namespace
+{
+
+// The JSON document of a SocketIO event, cut out the way the server did before the codec
+std::string eventData(const std::string &s)
+{
+    std::size_t b1 = s.find_first_of("[");
+    std::size_t b2 = s.find_first_of("}");
+    if (s.find("null") != std::string::npos || b1 == std::string::npos || b2 == std::string::npos)
+    {
+        return "";
+    }
+    return s.substr(b1, b2 - b1 + 2);
+}
+
+bool sameValues(const char *field, const std::vector<double> &values, const json &expected)
+{
+    if (values.size() != expected.size())
+    {
+        std::cerr << field << ": " << values.size() << " values, json.hpp reads " << expected.size() << std::endl;
+        return false;
+    }
+    for (std::size_t i = 0; i < values.size(); i++)
+    {
+        if (values[i] != expected[i].get<double>())
+        {
+            std::cerr << field << "[" << i << "]: " << values[i] << ", json.hpp reads " << expected[i]
+                      << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool sameValue(const char *field, double value, const json &expected)
+{
+    if (value != expected.get<double>())
+    {
+        std::cerr << field << ": " << value << ", json.hpp reads " << expected << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool checkTelemetry(const std::string &message, TelemetryFrame &frame)
+{
+    if (parseTelemetry(message.data(), message.length(), frame) != MessageType::kTelemetry)
+    {
+        std::cerr << "not read as telemetry" << std::endl;
+        return false;
+    }
+    const json document = json::parse(eventData(message));
+    const json &data = document[1];
+    bool same = sameValue("x", frame.car_x, data["x"]) && sameValue("y", frame.car_y, data["y"]) &&
+                sameValue("s", frame.car_s, data["s"]) && sameValue("d", frame.car_d, data["d"]) &&
+                sameValue("yaw", frame.car_yaw, data["yaw"]) &&
+                sameValue("speed", frame.car_speed, data["speed"]) &&
+                sameValues("previous_path_x", frame.previous_path_x, data["previous_path_x"]) &&
+                sameValues("previous_path_y", frame.previous_path_y, data["previous_path_y"]) &&
+                sameValue("end_path_s", frame.end_path_s, data["end_path_s"]) &&
+                sameValue("end_path_d", frame.end_path_d, data["end_path_d"]);
+    const SensorFusionFrame &cars = frame.sensor_fusion;
+    const json &expected = data["sensor_fusion"];
+    if (same && cars.size() != expected.size())
+    {
+        std::cerr << "sensor_fusion: " << cars.size() << " cars, json.hpp reads " << expected.size() << std::endl;
+        return false;
+    }
+    for (std::size_t i = 0; same && i < cars.size(); i++)
+    {
+        const json &car = expected[i];
+        same = sameValue("sensor_fusion id", cars.id[i], car[0]) &&
+               sameValue("sensor_fusion x", cars.x[i], car[1]) &&
+               sameValue("sensor_fusion y", cars.y[i], car[2]) &&
+               sameValue("sensor_fusion vx", cars.vx[i], car[3]) &&
+               sameValue("sensor_fusion vy", cars.vy[i], car[4]) &&
+               sameValue("sensor_fusion s", cars.s[i], car[5]) &&
+               sameValue("sensor_fusion d", cars.d[i], car[6]);
+    }
+    return same;
+}
+
+// Write the path at a precision and read it back: exact at -1, within half the last decimal at 6
+bool roundTrip(const ControlFrame &control, int precision, std::string &buffer, ControlFrame &read)
+{
+    serializeControl(control, precision, buffer);
+    if (!parseControl(buffer.data(), buffer.length(), read) || read.next_x.size() != control.next_x.size() ||
+        read.next_y.size() != control.next_y.size())
+    {
+        std::cerr << "precision " << precision << ": the written path does not read back" << std::endl;
+        return false;
+    }
+    double tolerance = precision < 0 ? 0.0 : 0.5 * pow(10.0, -precision) * (1.0 + 1e-9);
+    for (std::size_t i = 0; i < control.next_x.size(); i++)
+    {
+        if (fabs(read.next_x[i] - control.next_x[i]) > tolerance ||
+            fabs(read.next_y[i] - control.next_y[i]) > tolerance)
+        {
+            std::cerr << "precision " << precision << ": point " << i << " (" << control.next_x[i] << ", "
+                      << control.next_y[i] << ") reads back as (" << read.next_x[i] << ", " << read.next_y[i]
+                      << ")" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool checkControl(const std::string &message, ControlFrame &control, std::string &buffer, ControlFrame &read)
+{
+    if (!parseControl(message.data(), message.length(), control))
+    {
+        std::cerr << "not read as control" << std::endl;
+        return false;
+    }
+    const json document = json::parse(eventData(message));
+    const json &data = document[1];
+    return sameValues("next_x", control.next_x, data["next_x"]) &&
+           sameValues("next_y", control.next_y, data["next_y"]) && roundTrip(control, 6, buffer, read) &&
+           roundTrip(control, -1, buffer, read);
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    TelemetryFrame frame;
+    ControlFrame control;
+    ControlFrame read;
+    std::string buffer;
+    LogRecord record;
+    // differences are down to the last bit
+    std::cerr.precision(17);
+    for (int i = 1; i < argc; i++)
+    {
+        TelemetryLogReader reader;
+        if (!reader.open(argv[i]))
+        {
+            std::cerr << "Failed to open the log " << argv[i] << std::endl;
+            return 1;
+        }
+        unsigned long telemetry = 0, controls = 0;
+        while (reader.next(record))
+        {
+            bool same = record.type == RecordType::kTelemetry
+                    ? checkTelemetry(record.payload, frame)
+                    : checkControl(record.payload, control, buffer, read);
+            if (!same)
+            {
+                std::cerr << "in record " << telemetry + controls << " of " << argv[i] << std::endl;
+                return 1;
+            }
+            telemetry += record.type == RecordType::kTelemetry ? 1 : 0;
+            controls += record.type == RecordType::kControl ? 1 : 0;
+        }
+        std::cout << argv[i] << ": " << telemetry << " telemetry and " << controls
+                  << " control messages read like json.hpp" << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,155 @@
+#include <math.h>
+#include <cstdlib>
+#include <iostream>
+#include <random>
+#include <vector>
+#include "collision.h"
+#include "prediction.h"
+
+// Checks that the AVX kernel of the collision checker finds the same first contact as the scalar one
+// on random scenes: an ego path and a car path of up to 64 samples each, close enough that about a
+// third of the scenes touch. Also checks the checker itself with two cars standing on the first
+// point of the ego path. Exits with 1 on the first check that fails, 0 if they all pass; the kernels
+// are not compared if the CPU has no AVX.
+//
+//   obb_kernels [--scenes 20000] [--seed 1]
+
+namespace
+{
+
+// Two stopped cars on the first ego path point: the first one is the earliest contact there can be,
+// and the second one must not be checked over an empty stretch of the path
+bool contactAtFirstSample()
+{
+    // a straight road along x
+    std::vector<double> maps_s, maps_x, maps_y;
+    for (int i = 0; i < 40; i++)
+    {
+        maps_s.push_back(30.0 * i);
+        maps_x.push_back(30.0 * i);
+        maps_y.push_back(0.0);
+    }
+    SensorFusionFrame frame;
+    for (int i = 0; i < 2; i++)
+    {
+        frame.id.push_back(i);
+        frame.x.push_back(100.0);
+        frame.y.push_back(-6.0);
+        frame.vx.push_back(0.0);
+        frame.vy.push_back(0.0);
+        frame.s.push_back(100.0);
+        frame.d.push_back(6.0);
+    }
+    TrafficPrediction prediction;
+    prediction.predict(frame, nullptr, PredictionConfig());
+
+    // the ego drives slowly through them in the middle lane
+    double x[50], y[50];
+    for (int k = 0; k < 50; k++)
+    {
+        x[k] = 100.0 + 0.1 * k;
+        y[k] = -6.0;
+    }
+    ObbCollisionChecker checker;
+    checker.setMap(maps_s, maps_x, maps_y);
+    Collision first;
+    if (!checker.check(x, y, 50, 0.0, 100.0, prediction, &first) || first.sample != 0 || first.vehicle != 0)
+    {
+        std::cerr << "two cars on the first path point: no contact at the first sample" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    int scenes = 20000;
+    unsigned seed = 1;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--scenes")
+        {
+            scenes = atoi(argv[++i]);
+        }
+        else if (arg == "--seed")
+        {
+            seed = (unsigned) atoi(argv[++i]);
+        }
+    }
+    if (!contactAtFirstSample())
+    {
+        return 1;
+    }
+    if (!obbKernelAvailable(ObbKernel::kAvx))
+    {
+        std::cout << "no AVX kernel on this CPU, skipped" << std::endl;
+        return 0;
+    }
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<double> offset(-6.0, 6.0);
+    std::uniform_real_distribution<double> drift(-0.1, 0.1);
+    std::uniform_real_distribution<double> angle(-M_PI, M_PI);
+    std::uniform_real_distribution<double> extent(0.5, 3.0);
+    std::uniform_int_distribution<int> samples(1, 64);
+
+    std::vector<double> ax, ay, ac, as, bx, by, bc, bs;
+    int contacts = 0;
+    for (int scene = 0; scene < scenes; scene++)
+    {
+        ObbExtents e;
+        e.ha = extent(rng);
+        e.wa = 0.5 * extent(rng);
+        e.hb = extent(rng);
+        e.wb = 0.5 * extent(rng);
+
+        int n = samples(rng);
+        double x = offset(rng);
+        double y = offset(rng);
+        std::size_t padded = (n + 3) & ~3;
+        for (std::vector<double> *v : {&ax, &ay, &ac, &as, &bx, &by, &bc, &bs})
+        {
+            v->resize(padded);
+        }
+        for (int k = 0; k < n; k++)
+        {
+            // both cars drive along, the other one drifting towards or away from the ego
+            double a = angle(rng);
+            double b = angle(rng);
+            ax[k] = k * 0.4;
+            ay[k] = 0.0;
+            ac[k] = cos(a);
+            as[k] = sin(a);
+            x += drift(rng);
+            y += drift(rng);
+            bx[k] = k * 0.4 + x;
+            by[k] = y;
+            bc[k] = cos(b);
+            bs[k] = sin(b);
+        }
+        for (std::size_t k = n; k < padded; k++)
+        {
+            for (std::vector<double> *v : {&ax, &ay, &ac, &as, &bx, &by, &bc, &bs})
+            {
+                (*v)[k] = (*v)[n - 1];
+            }
+        }
+
+        int scalar = obbFirstContact(ObbKernel::kScalar, e, ax.data(), ay.data(), ac.data(), as.data(), bx.data(),
+                by.data(), bc.data(), bs.data(), n);
+        int avx = obbFirstContact(ObbKernel::kAvx, e, ax.data(), ay.data(), ac.data(), as.data(), bx.data(),
+                by.data(), bc.data(), bs.data(), n);
+        if (scalar != avx)
+        {
+            std::cerr << "scene " << scene << " of seed " << seed << ": scalar kernel found contact " << scalar
+                      << ", AVX kernel " << avx << std::endl;
+            return 1;
+        }
+        contacts += scalar >= 0 ? 1 : 0;
+    }
+    std::cout << scenes << " scenes, " << contacts << " with a contact: kernels agree" << std::endl;
+    return 0;
+}
@@ -0,0 +1,199 @@
+#include "occupancy.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+
+// bits first_bit..last_bit (inclusive, both within one word) set
+std::uint64_t wordMask(int first_bit, int last_bit)
+{
+    std::uint64_t hi = (last_bit == 63) ? ~0ULL : ((1ULL << (last_bit + 1)) - 1);
+    std::uint64_t lo = (1ULL << first_bit) - 1;
+    return hi & ~lo;
+}
+
+}  // namespace
+
+OccupancyGrid::OccupancyGrid(int max_steps, int num_lanes, int num_bins)
+    : max_steps_(max_steps), num_lanes_(num_lanes), num_bins_(num_bins), words_((num_bins + 63) / 64),
+      steps_(0), dt_(0.02), origin_(0.0)
+{
+    bits_.assign((std::size_t) (max_steps + 1) * num_lanes * words_, 0);
+}
+
+int OccupancyGrid::binOf(double s) const
+{
+    double rel = s - origin_;
+    // s wraps around the track
+    double half = 0.5 * config_.max_s;
+    if (rel > half)
+    {
+        rel -= config_.max_s;
+    }
+    else if (rel < -half)
+    {
+        rel += config_.max_s;
+    }
+    rel += config_.s_behind;
+    if (rel < 0.0)
+    {
+        return -1;
+    }
+    int bin = (int) (rel / config_.bin);
+    return bin < num_bins_ ? bin : -1;
+}
+
+bool OccupancyGrid::anyInRange(const std::uint64_t *bits, int first_bin, int last_bin) const
+{
+    int first_word = first_bin >> 6;
+    int last_word = last_bin >> 6;
+    if (first_word == last_word)
+    {
+        return (bits[first_word] & wordMask(first_bin & 63, last_bin & 63)) != 0;
+    }
+    if (bits[first_word] & wordMask(first_bin & 63, 63))
+    {
+        return true;
+    }
+    for (int w = first_word + 1; w < last_word; w++)
+    {
+        if (bits[w])
+        {
+            return true;
+        }
+    }
+    return (bits[last_word] & wordMask(0, last_bin & 63)) != 0;
+}
+
+void OccupancyGrid::setRange(std::uint64_t *bits, int first_bin, int last_bin)
+{
+    int first_word = first_bin >> 6;
+    int last_word = last_bin >> 6;
+    if (first_word == last_word)
+    {
+        bits[first_word] |= wordMask(first_bin & 63, last_bin & 63);
+        return;
+    }
+    bits[first_word] |= wordMask(first_bin & 63, 63);
+    for (int w = first_word + 1; w < last_word; w++)
+    {
+        bits[w] = ~0ULL;
+    }
+    bits[last_word] |= wordMask(0, last_bin & 63);
+}
+
+void OccupancyGrid::build(const TrafficPrediction &prediction, double ego_s, const OccupancyConfig &config)
+{
+    config_ = config;
+    origin_ = ego_s;
+    dt_ = prediction.dt();
+    steps_ = std::min(prediction.steps(), max_steps_);
+    std::fill(bits_.begin(), bits_.begin() + (std::size_t) (steps_ + 1) * num_lanes_ * words_, 0ULL);
+
+    double half_length = 0.5 * config_.car_length;
+    double half_width = 0.5 * config_.car_width;
+    std::size_t n = prediction.vehicles();
+    for (int k = 0; k <= steps_; k++)
+    {
+        const double *s = prediction.sAt(k);
+        const double *d = prediction.dAt(k);
+        for (std::size_t i = 0; i < n; i++)
+        {
+            int first_lane = std::max(0, (int) floor((d[i] - half_width) / config_.lane_width));
+            int last_lane = std::min(num_lanes_ - 1, (int) floor((d[i] + half_width) / config_.lane_width));
+            if (first_lane > last_lane)
+            {
+                continue;
+            }
+            int first_bin = binOf(s[i] - half_length);
+            int last_bin = binOf(s[i] + half_length);
+            if (first_bin < 0 && last_bin < 0)
+            {
+                continue;
+            }
+            // footprint partly outside the window
+            if (first_bin < 0)
+            {
+                first_bin = 0;
+            }
+            if (last_bin < 0)
+            {
+                last_bin = num_bins_ - 1;
+            }
+            for (int l = first_lane; l <= last_lane; l++)
+            {
+                setRange(row(k, l), first_bin, last_bin);
+            }
+        }
+    }
+}
+
+bool OccupancyGrid::occupied(int step, int lane, double s_lo, double s_hi) const
+{
+    if (step < 0 || step > steps_ || lane < 0 || lane >= num_lanes_)
+    {
+        return false;
+    }
+    int first_bin = binOf(s_lo);
+    int last_bin = binOf(s_hi);
+    if (first_bin < 0 && last_bin < 0)
+    {
+        return false;
+    }
+    if (first_bin < 0)
+    {
+        first_bin = 0;
+    }
+    if (last_bin < 0)
+    {
+        last_bin = num_bins_ - 1;
+    }
+    return anyInRange(row(step, lane), first_bin, last_bin);
+}
+
+bool OccupancyGrid::collides(int step, double s, double d) const
+{
+    // the footprints overlap if the ego's own footprint touches an occupied bin
+    double half_length = 0.5 * config_.car_length;
+    double half_width = 0.5 * config_.car_width;
+    int first_lane = std::max(0, (int) floor((d - half_width) / config_.lane_width));
+    int last_lane = std::min(num_lanes_ - 1, (int) floor((d + half_width) / config_.lane_width));
+    for (int l = first_lane; l <= last_lane; l++)
+    {
+        if (occupied(step, l, s - half_length, s + half_length))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+int OccupancyGrid::firstCollision(const double *s, const double *d, int n, int first_step) const
+{
+    for (int k = 0; k < n && first_step + k <= steps_; k++)
+    {
+        if (collides(first_step + k, s[k], d[k]))
+        {
+            return first_step + k;
+        }
+    }
+    return -1;
+}
+
+int OccupancyGrid::firstCollisionLaneChange(double s0, double v, int from_lane, int to_lane,
+        double change_time, int first_step) const
+{
+    double d0 = 0.5 * config_.lane_width + config_.lane_width * from_lane;
+    double d1 = 0.5 * config_.lane_width + config_.lane_width * to_lane;
+    for (int k = std::max(first_step, 0); k <= steps_; k++)
+    {
+        double t = (k - first_step) * dt_;
+        double u = change_time > 0.0 ? std::min(1.0, t / change_time) : 1.0;
+        if (collides(k, s0 + v * t, d0 + (d1 - d0) * u))
+        {
+            return k;
+        }
+    }
+    return -1;
+}
@@ -0,0 +1,69 @@
+#ifndef OCCUPANCY_H
+#define OCCUPANCY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "prediction.h"
+
+struct OccupancyConfig
+{
+    double s_behind = 64.0;     // window behind the ego's s [m]
+    double bin = 1.0;           // s resolution [m]
+    double car_length = 5.0;    // footprint of a car along s [m]
+    double car_width = 2.0;     // footprint of a car along d [m]
+    double lane_width = 4.0;
+    double max_s = 6945.554;    // s wraps around the track at this value
+};
+
+// Frenet-space occupancy of the predicted traffic, indexed by (time step, lane, s bin). Every
+// (time step, lane) pair owns a bitset over an s window that moves with the ego; a vehicle sets the
+// bins its footprint covers at each predicted step. Checking a candidate at one time step is then
+// a test of a few 64-bit words.
+class OccupancyGrid
+{
+public:
+    explicit OccupancyGrid(int max_steps = 150, int num_lanes = 3, int num_bins = 256);
+
+    // Rasterize the prediction in a window starting s_behind meters behind ego_s
+    void build(const TrafficPrediction &prediction, double ego_s, const OccupancyConfig &config);
+
+    // Whether anything occupies the given lane between s_lo and s_hi at a time step
+    bool occupied(int step, int lane, double s_lo, double s_hi) const;
+
+    // Whether a car-sized footprint centered at (s, d) overlaps predicted traffic at a time step
+    bool collides(int step, double s, double d) const;
+
+    // First step in [first_step, first_step + n) where the path (s[k], d[k]) collides, or -1.
+    // s[0], d[0] are the position at first_step.
+    int firstCollision(const double *s, const double *d, int n, int first_step) const;
+
+    // First colliding step of an ego that starts at s0 in the center of lane from_lane at first_step,
+    // drives at constant speed v [m/s] and moves over to the center of to_lane in change_time seconds.
+    // Returns -1 if the maneuver is clear until the end of the horizon.
+    int firstCollisionLaneChange(double s0, double v, int from_lane, int to_lane, double change_time,
+            int first_step) const;
+
+    int steps() const { return steps_; }
+    int lanes() const { return num_lanes_; }
+
+private:
+    // bin index of an s value, or -1 if outside the window
+    int binOf(double s) const;
+    const std::uint64_t *row(int step, int lane) const { return &bits_[(step * num_lanes_ + lane) * words_]; }
+    std::uint64_t *row(int step, int lane) { return &bits_[(step * num_lanes_ + lane) * words_]; }
+    bool anyInRange(const std::uint64_t *bits, int first_bin, int last_bin) const;
+    void setRange(std::uint64_t *bits, int first_bin, int last_bin);
+
+    int max_steps_;
+    int num_lanes_;
+    int num_bins_;
+    int words_;
+    int steps_;
+    double dt_;
+    double origin_;
+    OccupancyConfig config_;
+    std::vector<std::uint64_t> bits_;
+};
+
+#endif // OCCUPANCY_H
@@ -0,0 +1,157 @@
+#include "pipeline.h"
+
+FrameRing::FrameRing(std::size_t frame_capacity)
+    : back_(0), front_(2), middle_(1), dropped_(0)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        slots_[i].reserve(frame_capacity);
+    }
+}
+
+void FrameRing::publish()
+{
+    unsigned previous = middle_.exchange(back_ | kFresh, std::memory_order_acq_rel);
+    if (previous & kFresh)
+    {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    back_ = previous & kIndex;
+}
+
+bool FrameRing::take()
+{
+    if (!(middle_.load(std::memory_order_relaxed) & kFresh))
+    {
+        return false;
+    }
+    unsigned previous = middle_.exchange(front_, std::memory_order_acq_rel);
+    front_ = previous & kIndex;
+    return true;
+}
+
+PlannerPool::PlannerPool(unsigned threads, std::function<void()> notify)
+    : notify_(notify), running_(false), next_shard_(0)
+{
+    if (threads == 0)
+    {
+        threads = 1;
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+        shards_.emplace_back(new Shard());
+        shards_.back()->ready.reserve(64);
+    }
+    replies_.reserve(64);
+}
+
+PlannerPool::~PlannerPool()
+{
+    stop();
+}
+
+void PlannerPool::start()
+{
+    if (running_.exchange(true))
+    {
+        return;
+    }
+    for (std::size_t i = 0; i < shards_.size(); i++)
+    {
+        Shard &shard = *shards_[i];
+        shard.thread = std::thread([this, &shard] { run(shard); });
+    }
+}
+
+void PlannerPool::stop()
+{
+    if (!running_.exchange(false))
+    {
+        return;
+    }
+    for (std::size_t i = 0; i < shards_.size(); i++)
+    {
+        {
+            std::lock_guard<std::mutex> lock(shards_[i]->mutex);
+        }
+        shards_[i]->wake.notify_one();
+        shards_[i]->thread.join();
+        shards_[i]->ready.clear();
+    }
+}
+
+void PlannerPool::attach(PipelineSession &session)
+{
+    session.shard_ = next_shard_;
+    next_shard_ = (next_shard_ + 1) % shards_.size();
+}
+
+void PlannerPool::submit(const SessionPtr &session, const char *data, std::size_t length)
+{
+    session->incoming.back().assign(data, length);
+    session->incoming.publish();
+
+    // queue the session unless it is already waiting for its thread; the shard mutex only guards
+    // the queue itself and is never held while planning
+    if (!session->queued_.exchange(true))
+    {
+        Shard &shard = *shards_[session->shard_];
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.ready.push_back(session);
+        }
+        shard.wake.notify_one();
+    }
+}
+
+void PlannerPool::collectReplies(std::vector<SessionPtr> &sessions)
+{
+    sessions.clear();
+    std::lock_guard<std::mutex> lock(replies_mutex_);
+    sessions.swap(replies_);
+    for (std::size_t i = 0; i < sessions.size(); i++)
+    {
+        sessions[i]->reply_queued_.store(false);
+    }
+}
+
+void PlannerPool::run(Shard &shard)
+{
+    std::vector<SessionPtr> batch;
+    batch.reserve(64);
+    while (running_.load())
+    {
+        {
+            std::unique_lock<std::mutex> lock(shard.mutex);
+            shard.wake.wait(lock, [this, &shard] { return !shard.ready.empty() || !running_.load(); });
+            batch.swap(shard.ready);
+        }
+
+        bool replied = false;
+        for (std::size_t i = 0; i < batch.size(); i++)
+        {
+            PipelineSession &session = *batch[i];
+            // frames published after this point queue the session again
+            session.queued_.store(false);
+            if (!session.incoming.take() || !session.open.load())
+            {
+                continue;
+            }
+            if (session.handle(session.incoming.front(), session.outgoing.back()))
+            {
+                session.outgoing.publish();
+                if (!session.reply_queued_.exchange(true))
+                {
+                    std::lock_guard<std::mutex> lock(replies_mutex_);
+                    replies_.push_back(batch[i]);
+                }
+                replied = true;
+            }
+        }
+        batch.clear();
+        if (replied)
+        {
+            notify_();
+        }
+    }
+}
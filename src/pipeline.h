@@ -0,0 +1,115 @@
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Single-producer single-consumer hand-off where the newest frame wins. Three slots rotate between
+// the producer (back), the consumer (front) and the hand-off point (middle); publish() and take()
+// swap a slot with the middle one using one atomic exchange each, so neither side ever waits on the
+// other. A frame published before the consumer took the previous one replaces it.
+class FrameRing
+{
+public:
+    explicit FrameRing(std::size_t frame_capacity = 8192);
+
+    // producer side: fill back(), then publish() it
+    std::string &back() { return slots_[back_]; }
+    void publish();
+
+    // consumer side: take() the newest published frame, if any, then read it from front()
+    bool take();
+    const std::string &front() const { return slots_[front_]; }
+
+    bool pending() const { return (middle_.load(std::memory_order_acquire) & kFresh) != 0; }
+
+    // frames overwritten before the consumer got to them
+    unsigned long dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    static const unsigned kFresh = 4;
+    static const unsigned kIndex = 3;
+
+    std::string slots_[3];
+    unsigned back_;
+    unsigned front_;
+    std::atomic<unsigned> middle_;
+    std::atomic<unsigned long> dropped_;
+};
+
+// One client of the planner pool, e.g. one simulator connection. Frames go in through incoming,
+// replies come out through outgoing; handle() turns the one into the other on a pool thread and
+// is never called concurrently for the same session.
+class PipelineSession
+{
+public:
+    virtual ~PipelineSession() {}
+
+    // Plan one raw message; returns false if there is nothing to send back
+    virtual bool handle(const std::string &message, std::string &reply) = 0;
+
+    FrameRing incoming;
+    FrameRing outgoing;
+    // cleared by the network thread when the client goes away; late replies are then dropped
+    std::atomic<bool> open{true};
+
+private:
+    friend class PlannerPool;
+    unsigned shard_ = 0;
+    std::atomic<bool> queued_{false};
+    std::atomic<bool> reply_queued_{false};
+};
+
+// Planner threads shared by many sessions. Each session is pinned to one thread (its shard), so its
+// state is only ever touched by that thread and frames of one client are planned in order, while
+// different clients are planned in parallel. The network thread only copies frames into rings and
+// pushes a pointer onto a short queue; it never waits for planning.
+class PlannerPool
+{
+public:
+    typedef std::shared_ptr<PipelineSession> SessionPtr;
+
+    // notify is called from the planner threads whenever replies are ready (typically a uv_async_send)
+    PlannerPool(unsigned threads, std::function<void()> notify);
+    ~PlannerPool();
+
+    void start();
+    void stop();
+
+    // network thread: pin a new session to a thread, then feed it frames
+    void attach(PipelineSession &session);
+    void submit(const SessionPtr &session, const char *data, std::size_t length);
+
+    // network thread: sessions with a fresh reply in their outgoing ring since the last call
+    void collectReplies(std::vector<SessionPtr> &sessions);
+
+    unsigned threads() const { return (unsigned) shards_.size(); }
+
+private:
+    struct Shard
+    {
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::vector<SessionPtr> ready;
+        std::thread thread;
+    };
+
+    void run(Shard &shard);
+
+    std::vector<std::unique_ptr<Shard>> shards_;
+    std::function<void()> notify_;
+    std::atomic<bool> running_;
+    unsigned next_shard_;
+
+    std::mutex replies_mutex_;
+    std::vector<SessionPtr> replies_;
+};
+
+#endif // PIPELINE_H
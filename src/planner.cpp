@@ -0,0 +1,915 @@
+#include "planner.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/QR"
+#include "frame_arena.h"
+#include "spline.h"
+#include "stage_timer.h"
+
+using namespace std;
+
+namespace
+{
+
+// The spline the trajectories are fitted with, one per thread. Its coefficients and equation system keep
+// their capacity, so once warmed up setting new points does not allocate.
+struct TrajectoryWorkspace
+{
+    tk::spline spline;
+};
+
+TrajectoryWorkspace &trajectoryWorkspace()
+{
+    thread_local TrajectoryWorkspace workspace;
+    return workspace;
+}
+
+// Distance between points i and j of a path made of the previous path and the new points after it
+double pathDistance(const PathView &previous, const double *next_x, const double *next_y, int i, int j)
+{
+    double xi = i < previous.size ? previous.x[i] : next_x[i - previous.size];
+    double yi = i < previous.size ? previous.y[i] : next_y[i - previous.size];
+    double xj = j < previous.size ? previous.x[j] : next_x[j - previous.size];
+    double yj = j < previous.size ? previous.y[j] : next_y[j - previous.size];
+    return distance(xi, yi, xj, yj);
+}
+
+// Points of the previous path kept when a lane change under way turns back
+const int kTurnBackPoints = 10;
+
+// Next state that starts a maneuver of the behavior lookahead
+const char *maneuverState(Maneuver maneuver)
+{
+    return maneuver == Maneuver::kChangeLeft ? "LCL" : (maneuver == Maneuver::kChangeRight ? "LCR" : "KL");
+}
+
+}  // namespace
+
+// For converting back and forth between radians and degrees.
+double deg2rad(double x) { return x * pi() / 180; }
+
+// For converting back and forth between radians and degrees.
+double rad2deg(double x) { return x * 180 / pi(); }
+
+double distance(double x1, double y1, double x2, double y2)
+{
+	return sqrt((x2-x1)*(x2-x1)+(y2-y1)*(y2-y1));
+}
+
+int ClosestWaypoint(double x, double y, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+
+	double closestLen = 100000; //large number
+	int closestWaypoint = 0;
+
+	for(int i = 0; i < (int) maps_x.size(); i++)
+	{
+		double map_x = maps_x[i];
+		double map_y = maps_y[i];
+		double dist = distance(x,y,map_x,map_y);
+		if(dist < closestLen)
+		{
+			closestLen = dist;
+			closestWaypoint = i;
+		}
+
+	}
+
+	return closestWaypoint;
+
+}
+
+int NextWaypoint(double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+
+	int closestWaypoint = ClosestWaypoint(x,y,maps_x,maps_y);
+
+	double map_x = maps_x[closestWaypoint];
+	double map_y = maps_y[closestWaypoint];
+
+	double heading = atan2((map_y-y),(map_x-x));
+
+	double angle = fabs(theta-heading);
+  angle = min(2*pi() - angle, angle);
+
+  if(angle > pi()/4)
+  {
+    closestWaypoint++;
+  if (closestWaypoint == (int) maps_x.size())
+  {
+    closestWaypoint = 0;
+  }
+  }
+
+  return closestWaypoint;
+}
+
+// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+vector<double> getFrenet(double x, double y, double theta, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+	int next_wp = NextWaypoint(x,y, theta, maps_x,maps_y);
+
+	int prev_wp;
+	prev_wp = next_wp-1;
+	if(next_wp == 0)
+	{
+		prev_wp  = maps_x.size()-1;
+	}
+
+	double n_x = maps_x[next_wp]-maps_x[prev_wp];
+	double n_y = maps_y[next_wp]-maps_y[prev_wp];
+	double x_x = x - maps_x[prev_wp];
+	double x_y = y - maps_y[prev_wp];
+
+	// find the projection of x onto n
+	double proj_norm = (x_x*n_x+x_y*n_y)/(n_x*n_x+n_y*n_y);
+	double proj_x = proj_norm*n_x;
+	double proj_y = proj_norm*n_y;
+
+	double frenet_d = distance(x_x,x_y,proj_x,proj_y);
+
+	//see if d value is positive or negative by comparing it to a center point
+
+	double center_x = 1000-maps_x[prev_wp];
+	double center_y = 2000-maps_y[prev_wp];
+	double centerToPos = distance(center_x,center_y,x_x,x_y);
+	double centerToRef = distance(center_x,center_y,proj_x,proj_y);
+
+	if(centerToPos <= centerToRef)
+	{
+		frenet_d *= -1;
+	}
+
+	// calculate s value
+	double frenet_s = 0;
+	for(int i = 0; i < prev_wp; i++)
+	{
+		frenet_s += distance(maps_x[i],maps_y[i],maps_x[i+1],maps_y[i+1]);
+	}
+
+	frenet_s += distance(0,0,proj_x,proj_y);
+
+	return {frenet_s,frenet_d};
+
+}
+
+// Transform from Frenet s,d coordinates to Cartesian x,y
+vector<double> getXY(double s, double d, const vector<double> &maps_s, const vector<double> &maps_x, const vector<double> &maps_y)
+{
+	double x;
+	double y;
+	getXY(s, d, maps_s, maps_x, maps_y, x, y);
+	return {x,y};
+}
+
+void getXY(double s, double d, const vector<double> &maps_s, const vector<double> &maps_x,
+        const vector<double> &maps_y, double &x, double &y)
+{
+	int prev_wp = -1;
+
+	while(s > maps_s[prev_wp+1] && (prev_wp < (int)(maps_s.size()-1) ))
+	{
+		prev_wp++;
+	}
+
+	int wp2 = (prev_wp+1)%maps_x.size();
+
+	double heading = atan2((maps_y[wp2]-maps_y[prev_wp]),(maps_x[wp2]-maps_x[prev_wp]));
+	// the x,y,s along the segment
+	double seg_s = (s-maps_s[prev_wp]);
+
+	double seg_x = maps_x[prev_wp]+seg_s*cos(heading);
+	double seg_y = maps_y[prev_wp]+seg_s*sin(heading);
+
+	double perp_heading = heading-pi()/2;
+
+	x = seg_x + d*cos(perp_heading);
+	y = seg_y + d*sin(perp_heading);
+}
+
+int trajectoryPoints(int prev_size)
+{
+    return max(0, 50 - prev_size);
+}
+
+TrajectoryStart trajectoryStart(double car_x, double car_y, double car_yaw, const PathView &previous)
+{
+    // reference x, y, yaw states. either we will reference the starting point as i) where the
+    // car is, or ii) at the previous path's end point
+    TrajectoryStart start;
+    start.prev_size = previous.size;
+
+    if(previous.size < 2)
+    {
+        start.ref_x = car_x;
+        start.ref_y = car_y;
+        start.ref_yaw = deg2rad(car_yaw);
+
+        // use two points that make the path tangent to the car
+        start.prev_x = car_x - cos(car_yaw);
+        start.prev_y = car_y - sin(car_yaw);
+    }
+    else {
+        // redefine reference state as previous path's end point
+        start.ref_x = previous.x[previous.size - 1];
+        start.ref_y = previous.y[previous.size - 1];
+
+        // use two points that make the path tangent to the previous path's end point
+        start.prev_x = previous.x[previous.size - 2];
+        start.prev_y = previous.y[previous.size - 2];
+        start.ref_yaw = atan2(start.ref_y - start.prev_y, start.ref_x - start.prev_x);
+    }
+    return start;
+}
+
+namespace
+{
+
+// Fit the spline of a trajectory and sample count points of it. bounded stops where the spline stops
+// being a good path: past the last anchor but one, beyond which it bends towards a single anchor, or
+// where it turns away from the reference heading: the points are evenly spaced in x, so there they
+// spread out and the car would speed up. A plan ends once a step is 0.02% longer than the first.
+int sampleSpline(const TrajectoryStart &start, int lane, double ref_vel, double car_s, const HighwayMap &map,
+        const vector<double> &par_wps, double *x_vals, double *y_vals, int count, bool bounded)
+{
+    // create a list of widely spaced (x, y) waypoints, evenly spaced at 30m. Later we will interpolate
+    // these points with a spline and fill with more points, such that the speed is controlled.
+    double ptsx[5] = {start.prev_x, start.ref_x};
+    double ptsy[5] = {start.prev_y, start.ref_y};
+    double ref_x = start.ref_x;
+    double ref_y = start.ref_y;
+    double ref_yaw = start.ref_yaw;
+
+    // In Frenet add evenly 30m spaced points ahead of the starting reference
+    // Complete the 5 spaced waypoints:
+    for (int i = 0; i < 3; i++)
+    {
+        getXY(car_s+par_wps[i], 2+4*lane, map.s, map.x, map.y, ptsx[2+i], ptsy[2+i]);
+    }
+
+    // Transformation to car's system of reference, such that the last point of the previous path's
+    // at (0, 0) with a zero angle
+    for(int i=0; i < 5; i++)
+    {
+        double shift_x = ptsx[i]-ref_x;
+        double shift_y = ptsy[i]-ref_y;
+
+        ptsx[i] = shift_x*cos(0-ref_yaw)-shift_y*sin(0-ref_yaw);
+        ptsy[i] = shift_x*sin(0-ref_yaw)+shift_y*cos(0-ref_yaw);
+    }
+
+    // Create a spline
+    tk::spline &spl = trajectoryWorkspace().spline;
+
+    // Set (x,y) points to the spline
+    spl.set_points(ptsx, ptsy, 5);
+
+    // Calculate how to break up spline points such that we travel at desired reference velocity:
+    double target_x = par_wps[3];
+    double target_y = spl(target_x);
+    double target_d = sqrt(target_x*target_x + target_y*target_y);
+
+    // Fill out the rest of our path planner [after the previous path] such that we always output 50
+    double x_addon = 0;
+    double y_addon = 0;
+    double first_step = 0;
+    for(int i = 0; i < count; i++)
+    {
+        double N = (target_d/(0.02*ref_vel/2.24));
+        double x_point = x_addon+(target_x)/N;
+        double y_point = spl(x_point);
+        if (bounded)
+        {
+            double step = distance(x_addon, y_addon, x_point, y_point);
+            first_step = (i == 0) ? step : first_step;
+            if (x_point > ptsx[3] || step > 1.0002 * first_step)
+            {
+                return i;
+            }
+        }
+        x_addon = x_point;
+        y_addon = y_point;
+
+        double x_ref = x_point;
+        double y_ref = y_point;
+
+        // rotate back to global coordinates:
+        x_point = x_ref*cos(ref_yaw)-y_ref*sin(ref_yaw);
+        y_point = x_ref*sin(ref_yaw)+y_ref*cos(ref_yaw);
+
+        x_point += ref_x;
+        y_point += ref_y;
+
+        x_vals[i] = x_point;
+        y_vals[i] = y_point;
+    }
+    return count;
+}
+
+// The cached plan can go on if the planner keeps its lane and velocity, the previous path is what is
+// left of the last path sent, and enough sampled points remain
+bool planHolds(const TrajectoryPlan &plan, int lane, double ref_vel, const PathView &previous, int points)
+{
+    if (plan.lane != lane || plan.ref_vel != ref_vel || plan.size - plan.next < points || previous.size == 0)
+    {
+        return false;
+    }
+    // the path comes back with only the decimals it was sent with
+    return fabs(previous.x[previous.size - 1] - plan.last_x) < 1e-3 &&
+           fabs(previous.y[previous.size - 1] - plan.last_y) < 1e-3;
+}
+
+// Generate the points after the previous path. With sample_ahead the spline is sampled as far as it
+// follows the lane and the points beyond the path are kept in the plan for the next frames.
+void planTrajectory(TrajectoryPlan &plan, bool sample_ahead, const TrajectoryStart &start, int lane,
+        double ref_vel, double car_s, const HighwayMap &map, const vector<double> &par_wps,
+        double *x_vals, double *y_vals, int points)
+{
+    plan.next = 0;
+    plan.size = 0;
+    if (sample_ahead)
+    {
+        int sampled = sampleSpline(start, lane, ref_vel, car_s, map, par_wps, plan.x.data(), plan.y.data(),
+                (int) plan.x.size(), true);
+        if (sampled >= points)
+        {
+            copy(plan.x.begin(), plan.x.begin() + points, x_vals);
+            copy(plan.y.begin(), plan.y.begin() + points, y_vals);
+            plan.next = points;
+            plan.size = sampled;
+            return;
+        }
+    }
+    generateTrajectory(start, lane, ref_vel, car_s, map, par_wps, x_vals, y_vals, points);
+}
+
+}  // namespace
+
+// Define a path made up of (x,y) points that the car will visit sequentially every .02 seconds
+int generateTrajectory(const TrajectoryStart &start, int lane, double ref_vel, double car_s, const HighwayMap &map,
+        const vector<double> &par_wps, double *x_vals, double *y_vals, int capacity)
+{
+    return sampleSpline(start, lane, ref_vel, car_s, map, par_wps, x_vals, y_vals,
+            min(trajectoryPoints(start.prev_size), capacity), false);
+}
+
+// Detect proximity of a car ahead of us
+void detectCarProximity(int prev_size, const PlannerParams &params, double car_s, double car_v, double end_path_s,
+        const SensorFusionFrame &sensor_fusion, const TrafficPrediction &prediction, int lane,
+        bool &ahead_flag, bool &left_flag, bool &right_flag, bool &emerg_flag, double &target_vel)
+{
+    const double gap = params.gap;
+    double car_future_s;
+    // the following define parameters of the sensor fusion data, i.e. parameters of other cars
+    double d;
+    double s;
+    double v;
+
+    // the other cars are looked at when our car reaches the end of the previous path
+    int future_step = min(prev_size, prediction.steps());
+
+    // what our car s will look like in the future
+    if (prev_size > 0)
+    {
+        car_future_s = end_path_s;
+    }
+    else
+    {
+        car_future_s = car_s;
+    }
+
+    // Go through sensor fusion data for i cars and take action if there's a car in my lane
+    for (int i = 0; i < (int) sensor_fusion.size(); i++)
+    {
+        d = sensor_fusion.d[i];
+        // if another car is in my lane
+        if ((d < 2 + 4 * lane + 2) && (d > 2 + 4 * lane - 2))
+        {
+            v = prediction.speed(i);
+
+            // using the predicted motion we can project the car so we know what it'll look like in the future
+            s = prediction.s(future_step, i);
+
+            // knowing this, is our car_s close to the other car's s? if in front of us, and gap < X [m]:
+            if ((s > car_future_s) && (s - car_future_s < gap))
+            {
+                ahead_flag = true;
+                target_vel = v;
+            }
+            else if (abs(s - car_future_s) < gap/2.0 && abs(v - car_v) > 15)
+            {
+                emerg_flag = true;
+            }
+        }
+        // if another car is in my left lane
+        // gap+2 adelante  y < 5 por atras
+        else if ((d < 2 + 4 * (lane-1) + 2) && (d > 2 + 4 * (lane-1) - 2) && lane > 0)
+        {
+            v = prediction.speed(i);
+
+            // using the predicted motion we can project the car so we know what it'll look like in the future
+            s = prediction.s(future_step, i);
+
+            // knowing this, is our car_s close to the other car's s?:
+            if (((s - car_future_s) < gap && (car_future_s -s) < 2) ||
+                ((s - car_future_s) < gap+4 && (car_future_s -s) < 2 && v < params.slower_ratio*car_v) ||
+                ((s - car_future_s) < gap   && (car_future_s -s) < 6 && v > params.faster_ratio*car_v))
+            {
+                left_flag = true;
+            }
+        }
+        // if another car is in my right lane
+        if ((d < 2 + 4 * (lane+1) + 2) && (d > 2 + 4 * (lane+1) - 2) && lane < 2)
+        {
+            v = prediction.speed(i);
+
+            // using the predicted motion we can project the car so we know what it'll look like in the future
+            s = prediction.s(future_step, i);
+
+            // knowing this, is our car_s close to the other car's s?:
+            if (((s - car_future_s) < gap && (car_future_s -s) < 2) ||
+                ((s - car_future_s) < gap+4 && (car_future_s -s) < 2 && v < params.slower_ratio*car_v) ||
+                ((s - car_future_s) < gap   && (car_future_s -s) < 6 && v > params.faster_ratio*car_v))
+            {
+                right_flag = true;
+            }
+        }
+    }
+}
+
+// Screen a lane change against the predicted traffic occupancy. The maneuver starts at the end of the
+// previous path and keeps the reference velocity; returns true if it runs into another car within
+// the prediction horizon
+bool laneChangeBlocked(const OccupancyGrid &occupancy, int lane, int target_lane, int prev_size,
+        double car_s, double end_path_s, double ref_vel)
+{
+    double start_s = (prev_size > 0) ? end_path_s : car_s;
+    double change_time = 2.0;       // seconds to move over to the next lane center
+    return occupancy.firstCollisionLaneChange(start_s, ref_vel / 2.24, lane, target_lane, change_time,
+            prev_size) >= 0;
+}
+
+// Gives a list if possible states for each iteration of the simulator
+std::vector<std::string> getPossibleStates(int lane)
+{
+    std::vector<std::string> states;
+    getPossibleStates(lane, states);
+    return states;
+}
+
+void getPossibleStates(int lane, std::vector<std::string> &states)
+{
+    states.clear();
+    if(lane == 0)
+    {
+        states.push_back("KL");
+        states.push_back("LCR");
+    }
+    else if(lane == 1)
+    {
+        states.push_back("KL");
+        states.push_back("LCR");
+        states.push_back("LCL");
+    }
+    else if(lane == 2)
+    {
+        states.push_back("KL");
+        states.push_back("LCL");
+    }
+}
+
+// trigger the transition function to change the current state:
+void getTransition(const std::vector<std::string> &possible_states, ArenaVector<double> &cost_v,
+        ArenaVector<double> &cost_a, std::string &next_s)
+{
+    // Find the extreme point, i.e. the trigger for the state transition
+    ArenaVector<double>::iterator result;
+    if (cost_a[0] > 0.00000001){
+        result = std::min_element(cost_a.begin(), cost_a.end());
+        next_s = possible_states[std::distance(cost_a.begin(), result)];
+    }
+    else {
+        result = std::max_element(cost_v.begin(), cost_v.end());
+        next_s = possible_states[std::distance(cost_v.begin(), result)];
+    }
+}
+
+// obtain costs for trajectories associated with each state
+int getCosts(bool ahead_flag, const std::vector<std::string> &possible_states, double ref_vel, int lane,
+        double car_s, const TrajectoryStart &start, const PathView &previous, const HighwayMap &map,
+        const PlannerParams &params, ArenaVector<double> &cost_v, ArenaVector<double> &cost_a, std::string &next_s,
+        std::chrono::steady_clock::time_point deadline)
+{
+    int hip_lane = lane;
+    int evaluated = 0;
+    if (ahead_flag) {
+        // the costs may live in the arena too, so they get their room before the scope opens
+        cost_v.reserve(cost_v.size() + possible_states.size());
+        cost_a.reserve(cost_a.size() + possible_states.size());
+
+        // Define the actual points for the trajectories: every candidate shares the previous path and
+        // where it ends, so only the points after it are generated
+        FrameArena &arena = FrameArena::local();
+        ArenaScope scope(arena);
+        ArenaAllocator<double> alloc(arena);
+        int points = trajectoryPoints(start.prev_size);
+        ArenaVector<double> next_x(points, 0.0, alloc);
+        ArenaVector<double> next_y(points, 0.0, alloc);
+        int size = previous.size + points;
+
+        for (int i = 0; i < (int) possible_states.size(); i++) {
+            // out of time: the first candidate is always scored, the rest only before the deadline
+            if (i > 0 && deadline != std::chrono::steady_clock::time_point::max() &&
+                std::chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            if (possible_states[i] == "LCL") {
+                hip_lane = lane - 1;
+            } else if (possible_states[i] == "LCR") {
+                hip_lane = lane + 1;
+            } else if (possible_states[i] == "KL") {
+                hip_lane = lane;
+            }
+
+            generateTrajectory(start, hip_lane, ref_vel, car_s, map, params.wps, next_x.data(), next_y.data(),
+                               points);
+
+            // Compute the first cost function
+            double cost = 0.0;
+            for (int j = size - 2; j < size - 1; j++) {
+                cost += (2.236936 * pathDistance(previous, next_x.data(), next_y.data(), j, j + 1) / 0.02)
+                        - ref_vel;
+            }
+            cost_v.push_back(cost * cost);
+
+            // Compute the second cost function
+            double cost2;
+            cost2 = (2.236936 * pathDistance(previous, next_x.data(), next_y.data(), 48, 49) / 0.02) -
+                    (2.236936 * pathDistance(previous, next_x.data(), next_y.data(), 46, 47) / 0.02);
+            cost_a.push_back((cost2 - 0.0) * (cost2 - 0.0));
+            evaluated++;
+        }
+        getTransition(possible_states, cost_v, cost_a, next_s);
+    }
+    return evaluated;
+}
+
+// Given the next state, i know what lane to change into
+int chooseNextState(const std::string &state, int prev_lane)
+{
+    int lane = prev_lane;
+    if(state == "KL")
+    {
+        lane = prev_lane;
+    }
+    else if(state == "LCL")
+    {
+        lane = prev_lane-1;
+    }
+    else if(state == "LCR")
+    {
+        lane = prev_lane+1;
+    }
+    return lane;
+}
+
+// Given the next state, i know what lane to change into
+void actionNextState(const std::string &next_state, const bool &flag_ahead, const bool &flag_left,
+        const bool &flag_right, const bool &flag_emerg, const PlannerParams &params, double &ref_vel,
+        double &target_vel, int &lane)
+{
+    const double accpf = params.accpf;
+
+    // following refer to the KL state:
+    if (ref_vel < 49.5 && flag_ahead == 0) {
+        ref_vel += 1.*accpf;
+    }
+    else if (ref_vel < 49.5 && flag_ahead == 0 && flag_emerg) {
+        ref_vel += 1.8*accpf;
+    }
+    else if (flag_ahead && flag_emerg) {
+        ref_vel -= 1.8*accpf;
+    }
+    else if (next_state == "KL" && flag_ahead) {
+        if(target_vel < 0.9*ref_vel){
+            ref_vel -= 1.*accpf;
+        } else if (target_vel >= 0.9*ref_vel){
+            ref_vel += 1.*accpf;
+        }
+    }
+
+    // following two refer to the LCL state:
+    else if (next_state == "LCL" && flag_ahead && flag_left == 0) {
+        lane = chooseNextState(next_state, lane);
+        ref_vel += 0.0;
+    }
+    else if (next_state == "LCL" && flag_ahead && flag_left) {
+        if(target_vel < ref_vel){
+            ref_vel -= 1.*accpf;
+        } else if (target_vel >= ref_vel){
+            ref_vel += 1.*accpf;
+        }
+    }
+
+    // following two refer to the LCR state:
+    else if (next_state == "LCR" && flag_ahead && flag_right == 0) {
+        lane = chooseNextState(next_state, lane);
+        ref_vel += 0.0;
+    }
+    else if (next_state == "LCR" && flag_ahead && flag_right) {
+        if(target_vel < ref_vel){
+            ref_vel -= 1.*accpf;
+        } else if (target_vel >= ref_vel){
+            ref_vel += 1.*accpf;
+        }
+    }
+}
+
+bool loadHighwayMap(const string &file, HighwayMap &map)
+{
+  ifstream in_map_(file.c_str(), ifstream::in);
+
+  string line;
+  while (getline(in_map_, line)) {
+  	istringstream iss(line);
+  	double x;
+  	double y;
+  	float s;
+  	float d_x;
+  	float d_y;
+  	iss >> x;
+  	iss >> y;
+  	iss >> s;
+  	iss >> d_x;
+  	iss >> d_y;
+  	map.x.push_back(x);
+  	map.y.push_back(y);
+  	map.s.push_back(s);
+  	map.dx.push_back(d_x);
+  	map.dy.push_back(d_y);
+  }
+  return !map.x.empty();
+}
+
+Planner::Planner(const HighwayMap &map) : map_(map), ctx_(map.max_s)
+{
+    ctx_.collision_checker.setMap(map.s, map.x, map.y);
+}
+
+void Planner::step(const TelemetryFrame &telemetry, ControlFrame &control)
+{
+    plan(telemetry, control, std::chrono::steady_clock::now());
+}
+
+void Planner::plan(const TelemetryFrame &telemetry, ControlFrame &control,
+        std::chrono::steady_clock::time_point received)
+{
+    PlannerContext &ctx = ctx_;
+    int &lane = ctx.lane;
+    double &ref_vel = ctx.ref_vel;
+    double &target_vel = ctx.target_vel;
+    int &frame = ctx.frame;
+    int &sent_path_size = ctx.sent_path_size;
+    VehicleTracker &tracker = ctx.tracker;
+    TrafficPrediction &prediction = ctx.prediction;
+    OccupancyGrid &occupancy = ctx.occupancy;
+    ObbCollisionChecker &collision_checker = ctx.collision_checker;
+    const PredictionConfig &prediction_config = ctx.prediction_config;
+    const OccupancyConfig &occupancy_config = ctx.occupancy_config;
+    const PlannerParams &params = ctx.params;
+
+    // Temporaries of the frame come from the arena of this thread and are given back when the frame ends
+    FrameArena &arena = FrameArena::local();
+    ArenaScope frame_scope(arena);
+
+    // Main car's localization Data
+    double car_x = telemetry.car_x;
+    double car_y = telemetry.car_y;
+    double car_s = telemetry.car_s;
+    double car_yaw = telemetry.car_yaw;
+    double car_speed = telemetry.car_speed;
+
+    // Previous path data given to the Planner
+    const vector<double> &previous_path_x = telemetry.previous_path_x;
+    const vector<double> &previous_path_y = telemetry.previous_path_y;
+    PathView previous(previous_path_x, previous_path_y);
+    // Previous path's end s value
+    double end_path_s = telemetry.end_path_s;
+
+    // Sensor Fusion Data, a list of all other cars on the same side of the road.
+    const SensorFusionFrame &sensor_fusion = telemetry.sensor_fusion;
+
+    int prev_size = previous_path_x.size();
+
+    // the simulator consumed one point every .02 seconds since our last reply
+    double elapsed = (sent_path_size > prev_size) ? (sent_path_size - prev_size) * 0.02 : 0.0;
+    {
+        StageTimer timer(PlannerStage::kPredict);
+        tracker.update(sensor_fusion, elapsed);
+        prediction.predict(sensor_fusion, &tracker, prediction_config);
+        occupancy.build(prediction, car_s, occupancy_config);
+    }
+
+    // TODO: (done)  - Get a list of possible states
+    std::vector<std::string> &possible_states = ctx.possible_states;
+    getPossibleStates(lane, possible_states);
+
+    // TODO: (done)  - Detect proximity of a car ahead of us given a gap in meters
+    bool ahead_flag = false;        // flag that indicates proximity ahead
+    bool left_flag = false;         // flag that indicates proximity in the left lane
+    bool right_flag = false;        // flag that indicates proximity in the right lane
+    bool emerg_flag = false;        // flag that indicates proximity in the right lane
+
+    {
+        StageTimer timer(PlannerStage::kDetect);
+        detectCarProximity(prev_size, params, car_s, car_speed, end_path_s, sensor_fusion, prediction,
+                lane, ahead_flag, left_flag, right_flag, emerg_flag, target_vel);
+
+        // double-check the free neighbor lanes against the predicted traffic over the whole maneuver
+        if (lane > 0 && !left_flag)
+        {
+            left_flag = laneChangeBlocked(occupancy, lane, lane - 1, prev_size, car_s, end_path_s, ref_vel);
+        }
+        if (lane < 2 && !right_flag)
+        {
+            right_flag = laneChangeBlocked(occupancy, lane, lane + 1, prev_size, car_s, end_path_s, ref_vel);
+        }
+    }
+
+    // TODO: (done)  - If there's a car ahead of us, generate trajectories for each possible state
+    // TODO: (done)  and compute their associated costs
+    ArenaAllocator<double> alloc(arena);
+    ArenaVector<double> cost_velocity(alloc);
+    ArenaVector<double> cost_acc(alloc);
+    std::string next_state;
+
+    // Where the new part of every trajectory of this frame starts, read from the previous path once
+    TrajectoryStart start = trajectoryStart(car_x, car_y, car_yaw, previous);
+
+    // Anytime mode: score the candidates most likely to win first, keeping the lane, then the lane
+    // changes that are not blocked, so whatever the deadline cuts off matters least
+    bool anytime = ctx.deadline.count() > 0;
+    std::chrono::steady_clock::time_point deadline =
+            anytime ? received + ctx.deadline : std::chrono::steady_clock::time_point::max();
+    if (anytime && possible_states.size() == 3 && right_flag && !left_flag)
+    {
+        possible_states[1].swap(possible_states[2]);
+    }
+
+    PlannerCounters &counters = ctx.counters;
+    {
+        StageTimer timer(PlannerStage::kCost);
+        if (ctx.lookahead && ahead_flag)
+        {
+            // look a few maneuvers ahead from where the new part of the path starts, e.g. to find an
+            // overtake two lanes over, and take the first maneuver of the best sequence
+            double start_s = (prev_size > 0) ? end_path_s : car_s;
+            ctx.behavior.search(prediction, start_s, ref_vel / 2.24, lane, prev_size * 0.02, ctx.behavior_plan,
+                    deadline);
+            next_state = maneuverState(ctx.behavior_plan.first());
+            counters.lookahead_rollouts += ctx.behavior.rollouts();
+            counters.lookahead_cache_hits += ctx.behavior.cacheHits();
+        }
+        else
+        {
+            int evaluated = getCosts(ahead_flag, possible_states, ref_vel, lane, car_s, start, previous, map_,
+                    params, cost_velocity, cost_acc, next_state, deadline);
+            if (ahead_flag)
+            {
+                counters.candidates += evaluated;
+                counters.skipped_candidates += possible_states.size() - evaluated;
+            }
+        }
+    }
+
+    counters.ahead += ahead_flag ? 1 : 0;
+    counters.left_blocked += left_flag ? 1 : 0;
+    counters.right_blocked += right_flag ? 1 : 0;
+    counters.emergency += emerg_flag ? 1 : 0;
+    counters.keep_lane += next_state == "KL" ? 1 : 0;
+    counters.change_left += next_state == "LCL" ? 1 : 0;
+    counters.change_right += next_state == "LCR" ? 1 : 0;
+
+    // TODO: (done) Take action
+    int prev_lane = lane;
+    actionNextState(next_state, ahead_flag, left_flag, right_flag, emerg_flag, params,
+            ref_vel, target_vel, lane);
+    next_state = "";
+
+    // TODO: (done) define a path made up of x,y points that the car will visit sequentially every .02s
+    // Define the actual points the planner will be using:
+    control.clear();
+    vector<double> &next_x_vals = control.next_x;
+    vector<double> &next_y_vals = control.next_y;
+    // Waypoints for the spline and how it will be broken up
+    const vector<double> &par_wps = params.par_wps;
+
+    TrajectoryPlan &plan = ctx.plan;
+
+    {
+        StageTimer timer(PlannerStage::kGenerate);
+        // Start with all of the previous path points (aka whatever is left from the previous iteration plan)
+        // and generate the rest behind them
+        int points = trajectoryPoints(prev_size);
+        next_x_vals.assign(previous_path_x.begin(), previous_path_x.end());
+        next_y_vals.assign(previous_path_y.begin(), previous_path_y.end());
+        next_x_vals.resize(prev_size + points);
+        next_y_vals.resize(prev_size + points);
+        double *tail_x = next_x_vals.data() + prev_size;
+        double *tail_y = next_y_vals.data() + prev_size;
+
+        // Cruising with nothing ahead: go on with the next points of the cached plan, as long as the
+        // whole path, the previous one included, still clears the traffic as predicted now
+        bool reused = false;
+        if (ctx.reuse_plan && !ahead_flag && planHolds(plan, lane, ref_vel, previous, points))
+        {
+            copy(plan.x.begin() + plan.next, plan.x.begin() + plan.next + points, tail_x);
+            copy(plan.y.begin() + plan.next, plan.y.begin() + plan.next + points, tail_y);
+            reused = !collision_checker.check(next_x_vals.data(), next_y_vals.data(), (int) next_x_vals.size(), 0.02,
+                    car_s, prediction);
+        }
+
+        if (reused)
+        {
+            plan.next += points;
+            counters.reused_plans++;
+        }
+        else
+        {
+            // sample ahead when this frame keeps the lane and velocity of the last one, so the next
+            // frames are likely to go on with the plan
+            bool cruising = ctx.reuse_plan && !ahead_flag && lane == plan.lane && ref_vel == plan.ref_vel;
+            planTrajectory(plan, cruising, start, lane, ref_vel, car_s, map_, par_wps, tail_x, tail_y, points);
+        }
+
+        // Exact check of a lane change, in every frame until the car is in the new lane: if the whole
+        // path runs into a car predicted in the target lane, go back to the lane the change started from.
+        // Once the change is under way the car turns back only while it is still in its old lane,
+        // keeping just the start of the previous path.
+        int change_from = (lane != prev_lane) ? prev_lane : ctx.change_from;
+        if (change_from >= 0 && !next_x_vals.empty() &&
+            (lane != prev_lane || fabs(telemetry.car_d - (2 + 4 * change_from)) < 2.0) &&
+            collision_checker.check(next_x_vals.data(), next_y_vals.data(), (int) next_x_vals.size(), 0.02, car_s,
+                    prediction, nullptr, lane))
+        {
+            lane = change_from;
+            counters.aborted_lane_changes++;
+            int keep = (lane == prev_lane) ? prev_size : min(prev_size, kTurnBackPoints);
+            PathView kept(previous_path_x.data(), previous_path_y.data(), keep);
+            TrajectoryStart turn_back = trajectoryStart(car_x, car_y, car_yaw, kept);
+            int turn_back_points = trajectoryPoints(keep);
+            next_x_vals.resize(keep + turn_back_points);
+            next_y_vals.resize(keep + turn_back_points);
+            planTrajectory(plan, false, turn_back, lane, ref_vel, car_s, map_, par_wps, next_x_vals.data() + keep,
+                    next_y_vals.data() + keep, turn_back_points);
+            change_from = -1;
+        }
+        // the change is done once the car is close to the center of its new lane
+        ctx.change_from = (change_from >= 0 && fabs(telemetry.car_d - (2 + 4 * lane)) > 0.5) ? change_from : -1;
+
+        plan.lane = lane;
+        plan.ref_vel = ref_vel;
+        plan.last_x = next_x_vals.empty() ? 0.0 : next_x_vals.back();
+        plan.last_y = next_y_vals.empty() ? 0.0 : next_y_vals.back();
+    }
+
+    // Continue
+    // a lane change that turned back is not under way any more
+    counters.lane_changes += lane != prev_lane && ctx.change_from >= 0 ? 1 : 0;
+    counters.deadline_misses += anytime && std::chrono::steady_clock::now() > deadline ? 1 : 0;
+    sent_path_size = next_x_vals.size();
+    frame += 1;
+}
+
+bool Planner::handleMessage(const char *data, size_t length, std::string &reply)
+{
+    std::chrono::steady_clock::time_point received = std::chrono::steady_clock::now();
+    StageTimer frame_timer(PlannerStage::kFrame);
+
+    // "42" at the start of the message means there's a websocket message event.
+    // The 4 signifies a websocket message
+    // The 2 signifies a websocket event
+    MessageType type;
+    {
+        StageTimer timer(PlannerStage::kParse);
+        type = parseTelemetry(data, length, ctx_.telemetry);
+    }
+
+    if (type == MessageType::kTelemetry)
+    {
+        plan(ctx_.telemetry, ctx_.control, received);
+
+        StageTimer timer(PlannerStage::kSerialize);
+        serializeControl(ctx_.control, ctx_.control_precision, reply);
+        return true;
+    }
+    else if (type == MessageType::kManual)
+    {
+        // Manual driving
+        reply = "42[\"manual\",{}]";
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,285 @@
+#ifndef PLANNER_H
+#define PLANNER_H
+
+#include <math.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "sensor_fusion.h"
+#include "tracker.h"
+#include "prediction.h"
+#include "occupancy.h"
+#include "collision.h"
+#include "behavior.h"
+#include "telemetry.h"
+#include "control.h"
+#include "frame_arena.h"
+
+// Tunable constants of the planner; the defaults are the hand-tuned values
+struct PlannerParams
+{
+    // vehicle gap in meters: cars closer than this ahead of us, or beside us, count as in the way
+    double gap = 28;
+    // velocity step per frame in mph; accpf*22.3 gives the acceleration in m/s2
+    double accpf = 0.294;
+    // spline anchors ahead of the car and the distance the points are spread over, in meters:
+    // wps for the candidate trajectories compared by getCosts, par_wps for the path sent out
+    std::vector<double> wps = {25, 50, 75, 25};
+    std::vector<double> par_wps = {55, 90, 135, 45};
+    // a car in the next lane slower or faster than these fractions of our speed blocks a lane
+    // change over a wider window
+    double slower_ratio = 0.8;
+    double faster_ratio = 1.2;
+};
+
+// Waypoint map of the highway
+struct HighwayMap
+{
+    // Waypoint's x,y,s and d normalized normal vectors
+    std::vector<double> x;
+    std::vector<double> y;
+    std::vector<double> s;
+    std::vector<double> dx;
+    std::vector<double> dy;
+    // The max s value before wrapping around the track back to 0
+    double max_s = 6945.554;
+};
+
+// Non-owning view of a path of (x,y) points, such as the previous path of the telemetry
+struct PathView
+{
+    const double *x = nullptr;
+    const double *y = nullptr;
+    int size = 0;
+
+    PathView() {}
+    PathView(const double *x, const double *y, int size) : x(x), y(y), size(size) {}
+    PathView(const std::vector<double> &x, const std::vector<double> &y)
+        : x(x.data()), y(y.data()), size((int) x.size()) {}
+};
+
+// Where the new part of a trajectory starts: the end of the previous path, or the car if hardly any of
+// it is left. Every trajectory of a frame starts there, so it is read from the previous path once.
+struct TrajectoryStart
+{
+    // reference point and heading the new points continue from
+    double ref_x = 0.0;
+    double ref_y = 0.0;
+    double ref_yaw = 0.0;
+    // the point before it, so that the new points leave the reference tangent to the path
+    double prev_x = 0.0;
+    double prev_y = 0.0;
+    // points of the previous path kept in front of the new ones
+    int prev_size = 0;
+};
+
+// Give me the constant pi
+constexpr double pi() { return M_PI; }
+
+// For converting back and forth between radians and degrees.
+double deg2rad(double x);
+double rad2deg(double x);
+
+double distance(double x1, double y1, double x2, double y2);
+
+int ClosestWaypoint(double x, double y, const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+
+int NextWaypoint(double x, double y, double theta, const std::vector<double> &maps_x,
+        const std::vector<double> &maps_y);
+
+// Transform from Cartesian x,y coordinates to Frenet s,d coordinates
+std::vector<double> getFrenet(double x, double y, double theta, const std::vector<double> &maps_x,
+        const std::vector<double> &maps_y);
+
+// Transform from Frenet s,d coordinates to Cartesian x,y
+std::vector<double> getXY(double s, double d, const std::vector<double> &maps_s,
+        const std::vector<double> &maps_x, const std::vector<double> &maps_y);
+void getXY(double s, double d, const std::vector<double> &maps_s, const std::vector<double> &maps_x,
+        const std::vector<double> &maps_y, double &x, double &y);
+
+// Number of points a trajectory adds behind a previous path of prev_size points, so that 50 go out
+int trajectoryPoints(int prev_size);
+
+TrajectoryStart trajectoryStart(double car_x, double car_y, double car_yaw, const PathView &previous);
+
+// Define a path made up of (x,y) points that the car will visit sequentially every .02 seconds: the
+// points that follow the previous path in the given lane at ref_vel. Writes at most capacity of them
+// into the caller's x_vals and y_vals and returns how many.
+int generateTrajectory(const TrajectoryStart &start, int lane, double ref_vel, double car_s, const HighwayMap &map,
+        const std::vector<double> &par_wps, double *x_vals, double *y_vals, int capacity);
+
+// Detect proximity of a car ahead of us
+void detectCarProximity(int prev_size, const PlannerParams &params, double car_s, double car_v, double end_path_s,
+        const SensorFusionFrame &sensor_fusion, const TrafficPrediction &prediction, int lane,
+        bool &ahead_flag, bool &left_flag, bool &right_flag, bool &emerg_flag, double &target_vel);
+
+// Screen a lane change against the predicted traffic occupancy
+bool laneChangeBlocked(const OccupancyGrid &occupancy, int lane, int target_lane, int prev_size,
+        double car_s, double end_path_s, double ref_vel);
+
+// Gives a list if possible states for each iteration of the simulator
+std::vector<std::string> getPossibleStates(int lane);
+void getPossibleStates(int lane, std::vector<std::string> &states);
+
+// trigger the transition function to change the current state:
+void getTransition(const std::vector<std::string> &possible_states, ArenaVector<double> &cost_v,
+        ArenaVector<double> &cost_a, std::string &next_s);
+
+// obtain costs for trajectories associated with each state, in the order given. Past the deadline no
+// further state is scored and the transition is chosen among those that were; returns their number.
+int getCosts(bool ahead_flag, const std::vector<std::string> &possible_states, double ref_vel, int lane,
+        double car_s, const TrajectoryStart &start, const PathView &previous, const HighwayMap &map,
+        const PlannerParams &params, ArenaVector<double> &cost_v, ArenaVector<double> &cost_a, std::string &next_s,
+        std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max());
+
+// Given the next state, i know what lane to change into
+int chooseNextState(const std::string &state, int prev_lane);
+
+void actionNextState(const std::string &next_state, const bool &flag_ahead, const bool &flag_left,
+        const bool &flag_right, const bool &flag_emerg, const PlannerParams &params, double &ref_vel,
+        double &target_vel, int &lane);
+
+// Points of the last trajectory sampled beyond the path sent out. While the planner keeps its lane and
+// velocity and the way stays clear, the next frames extend the path with these points instead of
+// fitting a new spline.
+struct TrajectoryPlan
+{
+    // lane and velocity of the last path sent, and its last point
+    int lane = -1;
+    double ref_vel = -1.0;
+    double last_x = 0.0;
+    double last_y = 0.0;
+    // sampled points in map coordinates; [next, size) are not sent yet
+    std::vector<double> x;
+    std::vector<double> y;
+    int next = 0;
+    int size = 0;
+};
+
+// What the planner saw and decided, counted over all frames of a session
+struct PlannerCounters
+{
+    // proximity flags raised
+    uint64_t ahead = 0;
+    uint64_t left_blocked = 0;
+    uint64_t right_blocked = 0;
+    uint64_t emergency = 0;
+    // next state chosen by the cost functions
+    uint64_t keep_lane = 0;
+    uint64_t change_left = 0;
+    uint64_t change_right = 0;
+    // lanes actually changed, and changes undone by the exact collision check
+    uint64_t lane_changes = 0;
+    uint64_t aborted_lane_changes = 0;
+    // frames that went on with the cached plan
+    uint64_t reused_plans = 0;
+    // candidate trajectories scored and left out at the deadline, and frames whose path was not ready
+    // by the deadline
+    uint64_t candidates = 0;
+    uint64_t skipped_candidates = 0;
+    uint64_t deadline_misses = 0;
+    // maneuvers rolled out by the behavior lookahead and taken from its cache
+    uint64_t lookahead_rollouts = 0;
+    uint64_t lookahead_cache_hits = 0;
+};
+
+// Planner state carried from one frame to the next, together with the buffers every frame reuses
+struct PlannerContext
+{
+    // The initial lane
+    int lane = 1;
+    // Reference velocity
+    double ref_vel = 0.0;
+    // Target vehicle velocity
+    double target_vel = 0.0;
+
+    int frame = 0;
+    // Number of points in the last path sent to the simulator
+    int sent_path_size = 0;
+
+    // Telemetry of the current message, parsed in place into buffers reused across frames
+    TelemetryFrame telemetry;
+    // Per-vehicle filtered state, persisted across frames
+    VehicleTracker tracker;
+    // Future positions of the other cars over the planning horizon, shared by every check of a frame
+    TrafficPrediction prediction;
+    PredictionConfig prediction_config;
+    // (time step, lane, s) occupancy of the predicted traffic, rebuilt once per frame
+    OccupancyGrid occupancy;
+    OccupancyConfig occupancy_config;
+    // Exact box-vs-box check of the lane changes that pass the coarse screening
+    ObbCollisionChecker collision_checker;
+    // Lane a lane change under way started from, -1 when the car is not changing lanes
+    int change_from = -1;
+    // Path of the reply, reused across frames
+    ControlFrame control;
+    // Next states considered, reused across frames
+    std::vector<std::string> possible_states;
+    // Trajectory sampled ahead, and whether cruising frames may go on with it; off by default as the
+    // paths differ from fitting a new spline every frame
+    TrajectoryPlan plan;
+    bool reuse_plan = false;
+    // Anytime mode: candidates are scored in priority order until this long after the frame came in,
+    // then the best one so far is taken. Zero scores all of them in the usual order.
+    std::chrono::microseconds deadline{0};
+    // Beam search over maneuver sequences that picks the next state in place of the one-step costs
+    // when on; off by default
+    BehaviorSearch behavior;
+    BehaviorPlan behavior_plan;
+    bool lookahead = false;
+    // Tunable constants
+    PlannerParams params;
+    PlannerCounters counters;
+    // Decimals of the coordinates sent back, -1 for the shortest exact representation
+    int control_precision = 6;
+
+    explicit PlannerContext(double max_s)
+        : tracker(256, max_s), prediction(64, 150), occupancy(150, 3, 256), collision_checker(64, 64)
+    {
+        telemetry.reserve(64, 64);
+        prediction_config.model = MotionModel::kLaneChangeIntent;
+        occupancy_config.max_s = max_s;
+        collision_checker.config.max_s = max_s;
+        control.reserve(64);
+        possible_states.reserve(3);
+        plan.x.resize(256);
+        plan.y.resize(256);
+    }
+};
+
+// Load the waypoints of a highway_map.csv; false if the file cannot be read or has no waypoints
+bool loadHighwayMap(const std::string &file, HighwayMap &map);
+
+// The planner of one car, independent of how telemetry reaches it. step() plans the path for one
+// frame; every buffer it works in is kept between frames or taken from the frame arena, so once they
+// have grown to the size of the traffic and the path, planning a frame does not allocate.
+class Planner
+{
+public:
+    // The map has to outlive the planner
+    explicit Planner(const HighwayMap &map);
+
+    // Plan the path for one telemetry frame into control, which is cleared first. The deadline of the
+    // anytime mode counts from the call.
+    void step(const TelemetryFrame &telemetry, ControlFrame &control);
+
+    // Handle one SocketIO message from the simulator and write the answer into reply; the deadline
+    // counts from the call. Returns false if the message needs no answer.
+    bool handleMessage(const char *data, std::size_t length, std::string &reply);
+
+    // State carried between frames: lane, velocities, tuning and counters
+    PlannerContext &context() { return ctx_; }
+    const PlannerContext &context() const { return ctx_; }
+    const HighwayMap &map() const { return map_; }
+
+private:
+    void plan(const TelemetryFrame &telemetry, ControlFrame &control,
+            std::chrono::steady_clock::time_point received);
+
+    const HighwayMap &map_;
+    PlannerContext ctx_;
+};
+
+#endif // PLANNER_H
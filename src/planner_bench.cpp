@@ -0,0 +1,380 @@
+#include <math.h>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "planner.h"
+#include "spline.h"
+
+// Microbenchmarks of the planner kernels, without uWS or a simulator, to track regressions per
+// kernel. Every kernel runs in batches until it has taken --min-time seconds, for every input size
+// it depends on: the waypoints of the map (the bundled map resampled), the cars of the sensor fusion
+// frame and the points left of the previous path.
+//
+//   planner_bench [--maps 181,724,2896] [--traffic 0,12,48] [--previous 0,10,47] [--filter kernel]
+//                 [--min-time 0.2] [--csv] [--map ../data/highway_map.csv]
+
+namespace
+{
+
+// Keeps results alive so the compiler cannot drop the work that produced them
+volatile double sink;
+
+struct BenchOptions
+{
+    std::vector<int> maps = {181, 724, 2896};
+    std::vector<int> traffic = {0, 12, 48};
+    std::vector<int> previous = {0, 10, 47};
+    std::string filter;
+    double min_time = 0.2;
+    bool csv = false;
+};
+
+std::vector<int> parseList(const char *text)
+{
+    std::vector<int> values;
+    std::istringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ','))
+    {
+        values.push_back(atoi(item.c_str()));
+    }
+    return values;
+}
+
+// The bundled map with its centre line sampled at n evenly spaced waypoints
+HighwayMap resampleMap(const HighwayMap &map, int n)
+{
+    if (n == (int) map.x.size())
+    {
+        return map;
+    }
+    HighwayMap resampled;
+    resampled.max_s = map.max_s;
+    for (int i = 0; i < n; i++)
+    {
+        double s = map.max_s * i / n;
+        std::vector<double> xy = getXY(s, 0.0, map.s, map.x, map.y);
+        resampled.x.push_back(xy[0]);
+        resampled.y.push_back(xy[1]);
+        resampled.s.push_back(s);
+    }
+    // unit normals pointing to the right of the direction of travel
+    for (int i = 0; i < n; i++)
+    {
+        int next = (i + 1) % n;
+        double heading = atan2(resampled.y[next] - resampled.y[i], resampled.x[next] - resampled.x[i]);
+        resampled.dx.push_back(sin(heading));
+        resampled.dy.push_back(-cos(heading));
+    }
+    return resampled;
+}
+
+// The ego car in the middle lane, the path it has left and the cars around it
+struct Scene
+{
+    double car_x;
+    double car_y;
+    double car_s;
+    double car_yaw;     // degrees
+    double car_speed;   // mph
+    double end_path_s;
+    std::vector<double> previous_path_x;
+    std::vector<double> previous_path_y;
+    SensorFusionFrame sensor_fusion;
+    TrafficPrediction prediction;
+
+    Scene(const HighwayMap &map, int traffic, int previous)
+        : prediction(std::max(1, traffic), 150)
+    {
+        // where the simulator starts the car, on a straight stretch heading along x
+        const double speed = 20.0;
+        car_s = 124.8;
+        std::vector<double> xy = getXY(car_s, 6.0, map.s, map.x, map.y);
+        std::vector<double> ahead = getXY(car_s + 1.0, 6.0, map.s, map.x, map.y);
+        car_x = xy[0];
+        car_y = xy[1];
+        car_yaw = rad2deg(atan2(ahead[1] - xy[1], ahead[0] - xy[0]));
+        car_speed = speed * 2.24;
+
+        // points every .02 s at the current speed
+        for (int i = 1; i <= previous; i++)
+        {
+            std::vector<double> p = getXY(car_s + speed * 0.02 * i, 6.0, map.s, map.x, map.y);
+            previous_path_x.push_back(p[0]);
+            previous_path_y.push_back(p[1]);
+        }
+        end_path_s = car_s + speed * 0.02 * previous;
+
+        // spread over the three lanes, from 60 m behind to 120 m ahead, some slower and some faster
+        sensor_fusion.reserve(traffic);
+        for (int i = 0; i < traffic; i++)
+        {
+            double s = car_s - 60.0 + 180.0 * (i + 0.5) / traffic;
+            double d = 2.0 + 4.0 * (i % 3);
+            double v = speed * (0.8 + 0.4 * ((i * 7) % 5) / 4.0);
+            std::vector<double> p = getXY(s, d, map.s, map.x, map.y);
+            std::vector<double> q = getXY(s + 1.0, d, map.s, map.x, map.y);
+            double heading = atan2(q[1] - p[1], q[0] - p[0]);
+            sensor_fusion.push_back(i, p[0], p[1], v * cos(heading), v * sin(heading), s, d);
+        }
+        prediction.predict(sensor_fusion, nullptr, PredictionConfig());
+    }
+};
+
+class BenchRunner
+{
+public:
+    explicit BenchRunner(const BenchOptions &options) : options_(options)
+    {
+        if (options_.csv)
+        {
+            std::cout << "kernel,map,traffic,previous,ns_per_op,ops" << std::endl;
+        }
+        else
+        {
+            char header[128];
+            snprintf(header, sizeof(header), "%-22s %6s %8s %9s %12s %12s\n", "kernel", "map", "traffic",
+                    "previous", "ns/op", "ops");
+            std::cout << header;
+        }
+    }
+
+    // Time fn, which does `batch` operations per call, with inputs of the given sizes (-1: not used)
+    void run(const char *kernel, int map, int traffic, int previous, int batch, const std::function<void()> &fn)
+    {
+        if (!options_.filter.empty() && options_.filter != kernel)
+        {
+            return;
+        }
+        fn();   // warm-up
+        long calls = 1;
+        double seconds = 0.0;
+        while (true)
+        {
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            for (long i = 0; i < calls; i++)
+            {
+                fn();
+            }
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            if (seconds >= options_.min_time)
+            {
+                break;
+            }
+            calls *= 2;
+        }
+        double ops = (double) calls * batch;
+        char line[160];
+        if (options_.csv)
+        {
+            snprintf(line, sizeof(line), "%s,%d,%d,%d,%.2f,%.0f\n", kernel, map, traffic, previous,
+                    1e9 * seconds / ops, ops);
+        }
+        else
+        {
+            snprintf(line, sizeof(line), "%-22s %6s %8s %9s %12.2f %12.0f\n", kernel, size(map).c_str(),
+                    size(traffic).c_str(), size(previous).c_str(), 1e9 * seconds / ops, ops);
+        }
+        std::cout << line << std::flush;
+    }
+
+private:
+    static std::string size(int n) { return n < 0 ? "-" : std::to_string(n); }
+
+    BenchOptions options_;
+};
+
+// Kernels that only depend on the map
+void benchMap(BenchRunner &bench, const HighwayMap &map)
+{
+    const int n = map.x.size();
+    const int queries = 64;
+    std::vector<double> qs, qx, qy, qtheta;
+    for (int i = 0; i < queries; i++)
+    {
+        double s = map.max_s * (i + 0.5) / queries;
+        std::vector<double> p = getXY(s, 2.0 + 4.0 * (i % 3), map.s, map.x, map.y);
+        std::vector<double> q = getXY(s + 1.0, 2.0 + 4.0 * (i % 3), map.s, map.x, map.y);
+        qs.push_back(s);
+        qx.push_back(p[0]);
+        qy.push_back(p[1]);
+        qtheta.push_back(atan2(q[1] - p[1], q[0] - p[0]));
+    }
+
+    bench.run("ClosestWaypoint", n, -1, -1, queries, [&]() {
+        int sum = 0;
+        for (int i = 0; i < queries; i++)
+        {
+            sum += ClosestWaypoint(qx[i], qy[i], map.x, map.y);
+        }
+        sink = sum;
+    });
+    bench.run("getFrenet", n, -1, -1, queries, [&]() {
+        double sum = 0.0;
+        for (int i = 0; i < queries; i++)
+        {
+            sum += getFrenet(qx[i], qy[i], qtheta[i], map.x, map.y)[0];
+        }
+        sink = sum;
+    });
+    bench.run("getXY", n, -1, -1, queries, [&]() {
+        double sum = 0.0;
+        for (int i = 0; i < queries; i++)
+        {
+            sum += getXY(qs[i], 6.0, map.s, map.x, map.y)[0];
+        }
+        sink = sum;
+    });
+}
+
+// The spline of a trajectory: five anchors in car coordinates, sampled at 50 points
+void benchSpline(BenchRunner &bench)
+{
+    std::vector<double> ptsx = {-1.0, 0.0, 30.0, 60.0, 90.0};
+    std::vector<double> ptsy = {0.01, 0.0, 1.5, 4.0, 4.2};
+    bench.run("spline::set_points", -1, -1, -1, 1, [&]() {
+        tk::spline s;
+        s.set_points(ptsx, ptsy);
+        sink = s(1.0);
+    });
+
+    tk::spline s;
+    s.set_points(ptsx, ptsy);
+    const int points = 50;
+    bench.run("spline::operator()", -1, -1, -1, points, [&]() {
+        double sum = 0.0;
+        for (int i = 0; i < points; i++)
+        {
+            sum += s(0.8 * i);
+        }
+        sink = sum;
+    });
+}
+
+void benchTrajectory(BenchRunner &bench, const HighwayMap &map, int previous)
+{
+    Scene scene(map, 0, previous);
+    PlannerParams params;
+    PathView previous_path(scene.previous_path_x, scene.previous_path_y);
+    TrajectoryStart start = trajectoryStart(scene.car_x, scene.car_y, scene.car_yaw, previous_path);
+    double x_vals[50];
+    double y_vals[50];
+    double car_s = previous > 0 ? scene.end_path_s : scene.car_s;
+    bench.run("generateTrajectory", map.x.size(), -1, previous, 1, [&]() {
+        int points = generateTrajectory(start, 1, 45.0, car_s, map, params.par_wps, x_vals, y_vals, 50);
+        sink = points > 0 ? x_vals[points - 1] : 0.0;
+    });
+
+    std::vector<std::string> states = getPossibleStates(1);
+    FrameArena &arena = FrameArena::local();
+    std::string next_state;
+    bench.run("getCosts", map.x.size(), -1, previous, 1, [&]() {
+        ArenaScope scope(arena);
+        ArenaAllocator<double> alloc(arena);
+        ArenaVector<double> cost_v(alloc);
+        ArenaVector<double> cost_a(alloc);
+        TrajectoryStart frame_start = trajectoryStart(scene.car_x, scene.car_y, scene.car_yaw, previous_path);
+        getCosts(true, states, 45.0, 1, car_s, frame_start, previous_path, map, params, cost_v, cost_a,
+                next_state);
+        sink = cost_v.empty() ? 0.0 : cost_v[0];
+    });
+}
+
+void benchProximity(BenchRunner &bench, const HighwayMap &map, int traffic, int previous)
+{
+    Scene scene(map, traffic, previous);
+    PlannerParams params;
+    bench.run("detectCarProximity", -1, traffic, previous, 1, [&]() {
+        bool ahead = false, left = false, right = false, emergency = false;
+        double target_vel = 0.0;
+        detectCarProximity(previous, params, scene.car_s, scene.car_speed, scene.end_path_s, scene.sensor_fusion,
+                scene.prediction, 1, ahead, left, right, emergency, target_vel);
+        sink = target_vel + ahead + left + right + emergency;
+    });
+
+    BehaviorSearch search;
+    BehaviorPlan plan;
+    bench.run("BehaviorSearch::search", -1, traffic, previous, 1, [&]() {
+        search.search(scene.prediction, scene.end_path_s, scene.car_speed / 2.24, 1, previous * 0.02, plan);
+        sink = plan.score;
+    });
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string map_file = "../data/highway_map.csv";
+    BenchOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--csv")
+        {
+            options.csv = true;
+        }
+        else if (i + 1 >= argc)
+        {
+            break;
+        }
+        else if (arg == "--maps")
+        {
+            options.maps = parseList(argv[++i]);
+        }
+        else if (arg == "--traffic")
+        {
+            options.traffic = parseList(argv[++i]);
+        }
+        else if (arg == "--previous")
+        {
+            options.previous = parseList(argv[++i]);
+        }
+        else if (arg == "--filter")
+        {
+            options.filter = argv[++i];
+        }
+        else if (arg == "--min-time")
+        {
+            options.min_time = atof(argv[++i]);
+        }
+        else if (arg == "--map")
+        {
+            map_file = argv[++i];
+        }
+    }
+
+    HighwayMap map;
+    if (!loadHighwayMap(map_file, map))
+    {
+        std::cerr << "Failed to load the map " << map_file << std::endl;
+        return 1;
+    }
+
+    BenchRunner bench(options);
+    for (std::size_t m = 0; m < options.maps.size(); m++)
+    {
+        benchMap(bench, resampleMap(map, options.maps[m]));
+    }
+    benchSpline(bench);
+    for (std::size_t m = 0; m < options.maps.size(); m++)
+    {
+        HighwayMap resampled = resampleMap(map, options.maps[m]);
+        for (std::size_t p = 0; p < options.previous.size(); p++)
+        {
+            benchTrajectory(bench, resampled, options.previous[p]);
+        }
+    }
+    for (std::size_t t = 0; t < options.traffic.size(); t++)
+    {
+        for (std::size_t p = 0; p < options.previous.size(); p++)
+        {
+            benchProximity(bench, map, options.traffic[t], options.previous[p]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,109 @@
+#include "prediction.h"
+#include <math.h>
+#include <algorithm>
+
+TrafficPrediction::TrafficPrediction(std::size_t max_vehicles, int max_steps)
+    : vehicles_(0), steps_(0), dt_(0.02)
+{
+    v0_.reserve(max_vehicles);
+    a0_.reserve(max_vehicles);
+    vd0_.reserve(max_vehicles);
+    d_target_.reserve(max_vehicles);
+    s_.reserve(max_vehicles * (max_steps + 1));
+    d_.reserve(max_vehicles * (max_steps + 1));
+}
+
+void TrafficPrediction::predict(const SensorFusionFrame &sensor_fusion, const VehicleTracker *tracker,
+        const PredictionConfig &config)
+{
+    std::size_t n = sensor_fusion.size();
+    vehicles_ = n;
+    steps_ = config.steps;
+    dt_ = config.dt;
+
+    v0_.resize(n);
+    a0_.resize(n);
+    vd0_.resize(n);
+    d_target_.resize(n);
+    s_.resize(n * (steps_ + 1));
+    d_.resize(n * (steps_ + 1));
+
+    // initial state of every vehicle
+    bool tracked = tracker != nullptr && tracker->speed().size() == n;
+    for (std::size_t i = 0; i < n; i++)
+    {
+        if (tracked)
+        {
+            v0_[i] = tracker->speed()[i];
+            a0_[i] = tracker->accel()[i];
+            vd0_[i] = tracker->lateralVelocity()[i];
+        }
+        else
+        {
+            double vx = sensor_fusion.vx[i];
+            double vy = sensor_fusion.vy[i];
+            v0_[i] = sqrt(vx * vx + vy * vy);
+            a0_[i] = 0.0;
+            vd0_[i] = 0.0;
+        }
+        s_[i] = sensor_fusion.s[i];
+        d_[i] = sensor_fusion.d[i];
+    }
+
+    if (config.model == MotionModel::kConstantVelocity)
+    {
+        for (int k = 1; k <= steps_; k++)
+        {
+            double t = (double) k * dt_;
+            double *s = &s_[k * n];
+            double *d = &d_[k * n];
+            for (std::size_t i = 0; i < n; i++)
+            {
+                s[i] = s_[i] + t * v0_[i];
+                d[i] = d_[i];
+            }
+        }
+        return;
+    }
+
+    // lane the car is heading to: the next lane center in the direction of its lateral motion
+    bool lane_change = config.model == MotionModel::kLaneChangeIntent;
+    double d_min = 2.0;
+    double d_max = 2.0 + 4.0 * (config.num_lanes - 1);
+    for (std::size_t i = 0; i < n; i++)
+    {
+        double d0 = d_[i];
+        double vd = vd0_[i];
+        if (lane_change && vd > config.lane_change_vd)
+        {
+            d_target_[i] = std::min(d_max, 4.0 * ceil((d0 + 0.25 - 2.0) / 4.0) + 2.0);
+        }
+        else if (lane_change && vd < -config.lane_change_vd)
+        {
+            d_target_[i] = std::max(d_min, 4.0 * floor((d0 - 0.25 - 2.0) / 4.0) + 2.0);
+        }
+        else
+        {
+            d_target_[i] = d0;
+            vd0_[i] = 0.0;
+        }
+    }
+
+    // integrate the speed step by step so it can saturate at 0 and max_speed
+    for (int k = 1; k <= steps_; k++)
+    {
+        double t = (double) k * dt_;
+        const double *s_prev = &s_[(k - 1) * n];
+        double *s = &s_[k * n];
+        double *d = &d_[k * n];
+        for (std::size_t i = 0; i < n; i++)
+        {
+            double v_prev = std::min(config.max_speed, std::max(0.0, v0_[i] + a0_[i] * (t - dt_)));
+            double v_next = std::min(config.max_speed, std::max(0.0, v0_[i] + a0_[i] * t));
+            s[i] = s_prev[i] + 0.5 * (v_prev + v_next) * dt_;
+
+            double d_free = d_[i] + vd0_[i] * t;
+            d[i] = vd0_[i] > 0.0 ? std::min(d_free, d_target_[i]) : std::max(d_free, d_target_[i]);
+        }
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef PREDICTION_H
+#define PREDICTION_H
+
+#include <cstddef>
+#include <vector>
+#include "sensor_fusion.h"
+#include "tracker.h"
+
+// Motion models available to the prediction stage
+enum class MotionModel
+{
+    kConstantVelocity,      // s advances at the current speed, d stays put
+    kConstantAcceleration,  // s follows the tracked acceleration, d stays put
+    kLaneChangeIntent       // constant acceleration in s, d drifts into the lane the car is heading to
+};
+
+struct PredictionConfig
+{
+    MotionModel model = MotionModel::kConstantVelocity;
+    int steps = 150;                // number of time steps after the current one
+    double dt = 0.02;               // time step [s], same as the simulator's path points
+    double max_speed = 30.0;        // speed cap of the constant-acceleration models [m/s]
+    double lane_change_vd = 0.5;    // lateral speed that counts as a lane change in progress [m/s]
+    int num_lanes = 3;
+};
+
+// Future (s, d) of every vehicle of a sensor fusion frame over the planning horizon, computed once
+// per frame and shared by every consumer. Samples are stored time-major, so the vehicles at one
+// time step are contiguous: s(k, i) is vehicle i (sensor fusion row) at time k * dt from now.
+// s is not wrapped at the end of the track, so it can be compared directly with the ego's s.
+class TrafficPrediction
+{
+public:
+    explicit TrafficPrediction(std::size_t max_vehicles = 64, int max_steps = 150);
+
+    // Predict all vehicles in sensor_fusion. If a tracker is given, its smoothed speed,
+    // acceleration and lateral velocity are used; otherwise the raw frame values are.
+    void predict(const SensorFusionFrame &sensor_fusion, const VehicleTracker *tracker,
+            const PredictionConfig &config);
+
+    std::size_t vehicles() const { return vehicles_; }
+    int steps() const { return steps_; }
+    double dt() const { return dt_; }
+
+    double s(int step, std::size_t vehicle) const { return s_[step * vehicles_ + vehicle]; }
+    double d(int step, std::size_t vehicle) const { return d_[step * vehicles_ + vehicle]; }
+    const double *sAt(int step) const { return &s_[step * vehicles_]; }
+    const double *dAt(int step) const { return &d_[step * vehicles_]; }
+
+    // speed each vehicle was predicted with [m/s]
+    double speed(std::size_t vehicle) const { return v0_[vehicle]; }
+
+private:
+    std::size_t vehicles_;
+    int steps_;
+    double dt_;
+
+    // per-vehicle initial state
+    std::vector<double> v0_;
+    std::vector<double> a0_;
+    std::vector<double> vd0_;
+    std::vector<double> d_target_;
+
+    // (steps + 1) x vehicles samples
+    std::vector<double> s_;
+    std::vector<double> d_;
+};
+
+#endif // PREDICTION_H
@@ -0,0 +1,181 @@
+#include "recorder.h"
+#include <cstring>
+
+namespace
+{
+
+const char kMagic[8] = {'P', 'P', 'L', 'O', 'G', '0', '0', '1'};
+const std::size_t kHeaderBytes = 1 + 4 + 8 + 4;
+
+void putLittleEndian(std::uint64_t value, int bytes, char *out)
+{
+    for (int i = 0; i < bytes; i++)
+    {
+        out[i] = (char) ((value >> (8 * i)) & 0xff);
+    }
+}
+
+std::uint64_t getLittleEndian(const unsigned char *in, int bytes)
+{
+    std::uint64_t value = 0;
+    for (int i = 0; i < bytes; i++)
+    {
+        value |= (std::uint64_t) in[i] << (8 * i);
+    }
+    return value;
+}
+
+}  // namespace
+
+TelemetryRecorder::TelemetryRecorder(std::size_t buffer_bytes)
+    : file_(nullptr), buffer_bytes_(buffer_bytes), stopping_(false), recorded_(0), dropped_(0)
+{
+    filling_.reserve(buffer_bytes_);
+    writing_.reserve(buffer_bytes_);
+}
+
+TelemetryRecorder::~TelemetryRecorder()
+{
+    close();
+}
+
+bool TelemetryRecorder::open(const std::string &path)
+{
+    close();
+    file_ = std::fopen(path.c_str(), "wb");
+    if (file_ == nullptr)
+    {
+        return false;
+    }
+    std::fwrite(kMagic, 1, sizeof(kMagic), file_);
+    start_ = std::chrono::steady_clock::now();
+    stopping_ = false;
+    filling_.clear();
+    writer_ = std::thread([this] { run(); });
+    return true;
+}
+
+void TelemetryRecorder::close()
+{
+    if (file_ == nullptr)
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_one();
+    writer_.join();
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::fclose(file_);
+    file_ = nullptr;
+}
+
+void TelemetryRecorder::record(RecordType type, std::uint32_t session, const char *data, std::size_t length)
+{
+    std::uint64_t time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start_).count();
+    char header[kHeaderBytes];
+    header[0] = (char) type;
+    putLittleEndian(session, 4, header + 1);
+    putLittleEndian(time_ns, 8, header + 5);
+    putLittleEndian(length, 4, header + 13);
+
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (file_ == nullptr || filling_.size() + kHeaderBytes + length > buffer_bytes_)
+        {
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        filling_.append(header, kHeaderBytes);
+        filling_.append(data, length);
+        // hand over once half the buffer is used, so the other half absorbs bursts while writing
+        wake = filling_.size() >= buffer_bytes_ / 2;
+    }
+    recorded_.fetch_add(1, std::memory_order_relaxed);
+    if (wake)
+    {
+        wake_.notify_one();
+    }
+}
+
+void TelemetryRecorder::run()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true)
+    {
+        // flush at least every 100 ms so a crashed run still leaves most of its log behind
+        wake_.wait_for(lock, std::chrono::milliseconds(100),
+                [this] { return stopping_ || filling_.size() >= buffer_bytes_ / 2; });
+        writing_.swap(filling_);
+        bool stopping = stopping_;
+        lock.unlock();
+
+        if (!writing_.empty())
+        {
+            std::fwrite(writing_.data(), 1, writing_.size(), file_);
+            std::fflush(file_);
+            writing_.clear();
+        }
+
+        lock.lock();
+        if (stopping && filling_.empty())
+        {
+            return;
+        }
+    }
+}
+
+TelemetryLogReader::TelemetryLogReader()
+    : file_(nullptr)
+{
+}
+
+TelemetryLogReader::~TelemetryLogReader()
+{
+    if (file_ != nullptr)
+    {
+        std::fclose(file_);
+    }
+}
+
+bool TelemetryLogReader::open(const std::string &path)
+{
+    if (file_ != nullptr)
+    {
+        std::fclose(file_);
+    }
+    file_ = std::fopen(path.c_str(), "rb");
+    if (file_ == nullptr)
+    {
+        return false;
+    }
+    char magic[sizeof(kMagic)];
+    if (std::fread(magic, 1, sizeof(magic), file_) != sizeof(magic) ||
+        std::memcmp(magic, kMagic, sizeof(kMagic)) != 0)
+    {
+        std::fclose(file_);
+        file_ = nullptr;
+        return false;
+    }
+    return true;
+}
+
+bool TelemetryLogReader::next(LogRecord &record)
+{
+    unsigned char header[kHeaderBytes];
+    if (file_ == nullptr || std::fread(header, 1, kHeaderBytes, file_) != kHeaderBytes)
+    {
+        return false;
+    }
+    record.type = (RecordType) header[0];
+    record.session = (std::uint32_t) getLittleEndian(header + 1, 4);
+    record.time_ns = getLittleEndian(header + 5, 8);
+    std::size_t length = (std::size_t) getLittleEndian(header + 13, 4);
+    record.payload.resize(length);
+    // a record cut short by a crash ends the log
+    return length == 0 || std::fread(&record.payload[0], 1, length, file_) == length;
+}
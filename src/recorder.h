@@ -0,0 +1,87 @@
+#ifndef RECORDER_H
+#define RECORDER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Binary log of the messages exchanged with the simulator. The file starts with the 8 byte magic
+// "PPLOG001", followed by records of
+//   u8 type | u32 session | u64 time in ns since the recorder was opened | u32 length | payload
+// with all integers little-endian and the payload the raw SocketIO message.
+enum class RecordType : std::uint8_t
+{
+    kTelemetry = 1,
+    kControl = 2
+};
+
+struct LogRecord
+{
+    RecordType type;
+    std::uint32_t session;
+    std::uint64_t time_ns;
+    std::string payload;
+};
+
+// Appends records to a log without touching the disk on the calling thread: record() copies the
+// message into an in-memory buffer and a writer thread flushes full buffers. If the writer falls
+// more than buffer_bytes behind, records are dropped and counted instead of blocking the planner.
+class TelemetryRecorder
+{
+public:
+    explicit TelemetryRecorder(std::size_t buffer_bytes = 4 << 20);
+    ~TelemetryRecorder();
+
+    bool open(const std::string &path);
+    // flush everything recorded so far and close the file
+    void close();
+    bool isOpen() const { return file_ != nullptr; }
+
+    // safe to call from any thread
+    void record(RecordType type, std::uint32_t session, const char *data, std::size_t length);
+
+    unsigned long recorded() const { return recorded_.load(std::memory_order_relaxed); }
+    unsigned long dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+private:
+    void run();
+
+    std::FILE *file_;
+    std::size_t buffer_bytes_;
+    std::chrono::steady_clock::time_point start_;
+
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    // records go into filling_ while the writer thread owns writing_
+    std::string filling_;
+    std::string writing_;
+    bool stopping_;
+    std::thread writer_;
+
+    std::atomic<unsigned long> recorded_;
+    std::atomic<unsigned long> dropped_;
+};
+
+// Reads a log written by TelemetryRecorder back one record at a time
+class TelemetryLogReader
+{
+public:
+    TelemetryLogReader();
+    ~TelemetryLogReader();
+
+    // false if the file cannot be read or is not a log
+    bool open(const std::string &path);
+    // next record into record, reusing its payload buffer; false at the end of the log
+    bool next(LogRecord &record);
+
+private:
+    std::FILE *file_;
+};
+
+#endif // RECORDER_H
@@ -0,0 +1,167 @@
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include "frame_arena.h"
+#include "planner.h"
+#include "recorder.h"
+#include "stage_timer.h"
+
+// Replays a log written with --record through the planner, without the simulator or uWS, as fast
+// as the planner goes. Every session of the log gets a fresh planner; each recorded reply is
+// compared with the one the current planner gives for the same telemetry.
+//
+//   replay <log> [--map ../data/highway_map.csv] [--repeat N]
+
+namespace
+{
+
+// Replayed state of one recorded connection
+struct ReplaySession
+{
+    explicit ReplaySession(const HighwayMap &map) : planner(map) { reply.reserve(4096); }
+
+    Planner planner;
+    std::string reply;
+    // the planner answered the last telemetry and that answer still waits for its recorded twin
+    bool pending = false;
+};
+
+struct Divergence
+{
+    unsigned long compared = 0;
+    unsigned long different = 0;
+    unsigned long length_mismatch = 0;
+    double max_deviation = 0.0;
+};
+
+// Largest distance between the points of two paths, infinite if they differ in length
+double pathDeviation(const ControlFrame &a, const ControlFrame &b)
+{
+    if (a.next_x.size() != b.next_x.size())
+    {
+        return INFINITY;
+    }
+    double deviation = 0.0;
+    for (size_t i = 0; i < a.next_x.size(); i++)
+    {
+        deviation = std::max(deviation, distance(a.next_x[i], a.next_y[i], b.next_x[i], b.next_y[i]));
+    }
+    return deviation;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <log> [--map highway_map.csv] [--repeat N]" << std::endl;
+        return 1;
+    }
+    std::string log_file = argv[1];
+    std::string map_file = "../data/highway_map.csv";
+    int repeat = 1;
+    for (int i = 2; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--map" && i + 1 < argc)
+        {
+            map_file = argv[++i];
+        }
+        else if (arg == "--repeat" && i + 1 < argc)
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+    }
+
+    HighwayMap map;
+    if (!loadHighwayMap(map_file, map))
+    {
+        std::cerr << "Failed to load the map " << map_file << std::endl;
+        return 1;
+    }
+
+    // the whole log is read up front, so the timing below only covers planning
+    std::vector<LogRecord> records;
+    {
+        TelemetryLogReader reader;
+        if (!reader.open(log_file))
+        {
+            std::cerr << "Failed to open the log " << log_file << std::endl;
+            return 1;
+        }
+        LogRecord record;
+        while (reader.next(record))
+        {
+            records.push_back(record);
+        }
+    }
+
+    Divergence divergence;
+    unsigned long frames = 0;
+    double planning_seconds = 0.0;
+    ControlFrame recorded;
+    ControlFrame replayed;
+    for (int pass = 0; pass < repeat; pass++)
+    {
+        std::map<std::uint32_t, std::unique_ptr<ReplaySession>> sessions;
+        for (size_t i = 0; i < records.size(); i++)
+        {
+            const LogRecord &record = records[i];
+            std::unique_ptr<ReplaySession> &session = sessions[record.session];
+            if (!session)
+            {
+                session.reset(new ReplaySession(map));
+            }
+
+            if (record.type == RecordType::kTelemetry)
+            {
+                std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+                session->pending = session->planner.handleMessage(record.payload.data(), record.payload.size(),
+                        session->reply);
+                planning_seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+                frames++;
+            }
+            else if (record.type == RecordType::kControl && session->pending && pass == 0)
+            {
+                session->pending = false;
+                divergence.compared++;
+                if (session->reply == record.payload)
+                {
+                    continue;
+                }
+                divergence.different++;
+                bool parsed = parseControl(record.payload.data(), record.payload.size(), recorded) &&
+                              parseControl(session->reply.data(), session->reply.size(), replayed);
+                double deviation = parsed ? pathDeviation(recorded, replayed) : INFINITY;
+                if (isinf(deviation))
+                {
+                    divergence.length_mismatch++;
+                }
+                else
+                {
+                    divergence.max_deviation = std::max(divergence.max_deviation, deviation);
+                }
+            }
+        }
+    }
+
+    std::cout << "records:            " << records.size() << std::endl;
+    std::cout << "frames planned:     " << frames << std::endl;
+    std::cout << "planning time:      " << planning_seconds << " s" << std::endl;
+    std::cout << "frames per second:  " << (planning_seconds > 0 ? frames / planning_seconds : 0) << std::endl;
+    std::cout << "mean frame time:    " << (frames > 0 ? 1e6 * planning_seconds / frames : 0) << " us" << std::endl;
+    std::cout << "replies compared:   " << divergence.compared << std::endl;
+    std::cout << "replies different:  " << divergence.different << std::endl;
+    std::cout << "  different length: " << divergence.length_mismatch << std::endl;
+    std::cout << "  max deviation:    " << divergence.max_deviation << " m" << std::endl;
+    std::cout << "frame arena peak:   " << FrameArena::local().peak() << " bytes, "
+              << FrameArena::local().overflows() << " overflows" << std::endl;
+    printStageReport(std::cout);
+    return divergence.different == 0 ? 0 : 2;
+}
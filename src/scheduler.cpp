@@ -0,0 +1,125 @@
+#include "scheduler.h"
+#include <algorithm>
+
+namespace
+{
+
+// The scheduler and worker the current thread belongs to, if any
+thread_local const TaskScheduler *current_scheduler = nullptr;
+thread_local unsigned current_worker = 0;
+
+}  // namespace
+
+TaskScheduler::TaskScheduler(unsigned threads)
+    : queued_(0), pending_(0), stopping_(false), next_(0), steals_(0)
+{
+    if (threads == 0)
+    {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers_.emplace_back(new Worker());
+    }
+    for (unsigned i = 0; i < threads; i++)
+    {
+        workers_[i]->thread = std::thread([this, i] { run(i); });
+    }
+}
+
+TaskScheduler::~TaskScheduler()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::size_t i = 0; i < workers_.size(); i++)
+    {
+        workers_[i]->thread.join();
+    }
+}
+
+void TaskScheduler::submit(Task task)
+{
+    unsigned index = current_scheduler == this ? current_worker
+                                               : next_.fetch_add(1, std::memory_order_relaxed) % threads();
+    pending_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex_);
+        queued_++;
+    }
+    wake_.notify_one();
+}
+
+void TaskScheduler::wait()
+{
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    done_.wait(lock, [this] { return pending_.load() == 0; });
+}
+
+bool TaskScheduler::take(unsigned index, Task &task)
+{
+    // own tasks newest first, while they are likely still in cache
+    {
+        Worker &own = *workers_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty())
+        {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            return true;
+        }
+    }
+    // then the oldest task of the next busy worker
+    for (std::size_t k = 1; k < workers_.size(); k++)
+    {
+        Worker &victim = *workers_[(index + k) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty())
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            steals_.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    return false;
+}
+
+void TaskScheduler::run(unsigned index)
+{
+    current_scheduler = this;
+    current_worker = index;
+    Task task;
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> lock(idle_mutex_);
+            wake_.wait(lock, [this] { return queued_ > 0 || stopping_; });
+            if (queued_ == 0)
+            {
+                return;
+            }
+            // claim one of the queued tasks; it is in some deque, though maybe not ours
+            queued_--;
+        }
+        while (!take(index, task))
+        {
+            // another worker claimed a task but has not taken it yet; it will show up
+            std::this_thread::yield();
+        }
+        task();
+        task = nullptr;
+        if (pending_.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(idle_mutex_);
+            done_.notify_all();
+        }
+    }
+}
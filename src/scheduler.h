@@ -0,0 +1,58 @@
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of threads running independent tasks with work stealing. Every worker has its own
+// deque: it runs its own tasks newest first, and when that runs dry it steals the oldest task of
+// another worker, so a few long tasks do not leave the other cores idle at the end of a batch.
+// Tasks submitted from a worker go to that worker's deque; others are dealt round-robin.
+class TaskScheduler
+{
+public:
+    typedef std::function<void()> Task;
+
+    // threads == 0 uses one thread per core
+    explicit TaskScheduler(unsigned threads = 0);
+    ~TaskScheduler();
+
+    void submit(Task task);
+    // Block until every task submitted so far, and every task those submitted, has finished
+    void wait();
+
+    unsigned threads() const { return (unsigned) workers_.size(); }
+    // tasks run by another worker than the one they were queued on
+    unsigned long steals() const { return steals_.load(std::memory_order_relaxed); }
+
+private:
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+    };
+
+    void run(unsigned index);
+    bool take(unsigned index, Task &task);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+
+    // idle workers sleep on wake_ until queued_ says there is something to take
+    std::mutex idle_mutex_;
+    std::condition_variable wake_;
+    std::condition_variable done_;
+    long queued_;
+    std::atomic<long> pending_;
+    bool stopping_;
+    std::atomic<unsigned> next_;
+    std::atomic<unsigned long> steals_;
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,59 @@
+#ifndef SENSOR_FUSION_H
+#define SENSOR_FUSION_H
+
+#include <cstddef>
+#include <vector>
+
+// Sensor fusion data for one telemetry frame, stored column-wise (one array per attribute) so that
+// the per-vehicle loops read contiguous memory. The columns keep their capacity between frames:
+// clear() only resets the size, so a frame reused across iterations stops allocating once warmed up.
+struct SensorFusionFrame
+{
+    std::vector<int> id;        // car's unique ID
+    std::vector<double> x;      // x position in map coordinates [m]
+    std::vector<double> y;      // y position in map coordinates [m]
+    std::vector<double> vx;     // x velocity [m/s]
+    std::vector<double> vy;     // y velocity [m/s]
+    std::vector<double> s;      // s position in frenet coordinates [m]
+    std::vector<double> d;      // d position in frenet coordinates [m]
+
+    std::size_t size() const { return id.size(); }
+    bool empty() const { return id.empty(); }
+
+    void clear()
+    {
+        id.clear();
+        x.clear();
+        y.clear();
+        vx.clear();
+        vy.clear();
+        s.clear();
+        d.clear();
+    }
+
+    void reserve(std::size_t n)
+    {
+        id.reserve(n);
+        x.reserve(n);
+        y.reserve(n);
+        vx.reserve(n);
+        vy.reserve(n);
+        s.reserve(n);
+        d.reserve(n);
+    }
+
+    // append one vehicle, with the attributes in the order the simulator sends them
+    void push_back(int car_id, double car_x, double car_y, double car_vx, double car_vy,
+            double car_s, double car_d)
+    {
+        id.push_back(car_id);
+        x.push_back(car_x);
+        y.push_back(car_y);
+        vx.push_back(car_vx);
+        vy.push_back(car_vy);
+        s.push_back(car_s);
+        d.push_back(car_d);
+    }
+};
+
+#endif // SENSOR_FUSION_H
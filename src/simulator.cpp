@@ -0,0 +1,467 @@
+#include "simulator.h"
+#include <math.h>
+#include <algorithm>
+
+namespace
+{
+
+const double kDt = 0.02;
+// samples in the .2 s window the accelerations are averaged over, and in the 1 s window of the
+// jerk. Over .2 s the jerk of the path points follows every step of the reference velocity, which
+// the Unity simulator does not flag: the planner drives its 4.7 miles there without an incident.
+const std::size_t kWindow = 10;
+const std::size_t kJerkWindow = 50;
+const double kCarLength = 5.0;
+const double kLaneWidth = 4.0;
+
+// intelligent driver model: max acceleration, comfortable braking, standstill gap, time headway
+const double kIdmAccel = 1.5;
+const double kIdmBrake = 2.0;
+const double kIdmGap = 4.0;
+const double kIdmHeadway = 1.5;
+const double kHardestBrake = 9.0;
+
+double laneCenter(int lane)
+{
+    return 2.0 + kLaneWidth * lane;
+}
+
+double wrapS(double s, double max_s)
+{
+    s = fmod(s, max_s);
+    return s < 0 ? s + max_s : s;
+}
+
+}  // namespace
+
+// Exact inverse of getXY: the waypoint segment (x, y) was placed along and the offset from it.
+// getFrenet is only an approximation that is off by metres around the waypoints, too far to grade
+// lanes and collisions by. The search starts from segment and covers the few segments around it,
+// falling back to the whole map if the point is not near any of them.
+void HighwaySimulator::toFrenet(double x, double y, std::size_t &segment, double &s, double &d) const
+{
+    std::size_t n = map_.x.size();
+    double best = INFINITY;
+    std::size_t best_segment = segment;
+    for (int pass = 0; pass < 2 && best > 2.0 * kLaneWidth * config_.num_lanes; pass++)
+    {
+        int from = pass == 0 ? -2 : 0;
+        int to = pass == 0 ? 4 : (int) n;
+        for (int k = from; k < to; k++)
+        {
+            std::size_t i = pass == 0 ? (segment + n + k) % n : (std::size_t) k;
+            std::size_t j = (i + 1) % n;
+            double ux = map_.x[j] - map_.x[i];
+            double uy = map_.y[j] - map_.y[i];
+            double length = sqrt(ux * ux + uy * uy);
+            ux /= length;
+            uy /= length;
+            double px = x - map_.x[i];
+            double py = y - map_.y[i];
+            double t = px * ux + py * uy;
+            double clamped = std::max(0.0, std::min(length, t));
+            double distance = hypot(px - clamped * ux, py - clamped * uy);
+            if (distance < best)
+            {
+                best = distance;
+                best_segment = i;
+                s = map_.s[i] + t;
+                // getXY offsets d to the right of the direction of travel
+                d = px * uy - py * ux;
+            }
+        }
+    }
+    segment = best_segment;
+}
+
+HighwaySimulator::HighwaySimulator(const HighwayMap &map, const SimulatorConfig &config)
+    : map_(map), config_(config)
+{
+    cars_.resize(std::max(0, config_.cars));
+    vx_.resize(kWindow + 1);
+    vy_.resize(kWindow + 1);
+    ax_.resize(kJerkWindow + 1);
+    ay_.resize(kJerkWindow + 1);
+    remaining_.reserve(64);
+    path_.reserve(64);
+    reset(config_.seed);
+}
+
+void HighwaySimulator::reset(unsigned seed)
+{
+    rng_.seed(seed);
+    next_id_ = 0;
+    metrics_ = SimulatorMetrics();
+
+    // where the Unity simulator puts the car: standing in the middle lane
+    ego_s_ = 124.8336;
+    ego_d_ = 6.164833;
+    std::vector<double> xy = getXY(ego_s_, ego_d_, map_.s, map_.x, map_.y);
+    std::vector<double> ahead = getXY(ego_s_ + 1.0, ego_d_, map_.s, map_.x, map_.y);
+    ego_x_ = xy[0];
+    ego_y_ = xy[1];
+    ego_yaw_ = atan2(ahead[1] - xy[1], ahead[0] - xy[0]);
+    ego_speed_ = 0.0;
+    ego_segment_ = 0;
+    double s, d;
+    toFrenet(ego_x_, ego_y_, ego_segment_, s, d);
+    remaining_.clear();
+
+    std::fill(vx_.begin(), vx_.end(), 0.0);
+    std::fill(vy_.begin(), vy_.end(), 0.0);
+    std::fill(ax_.begin(), ax_.end(), 0.0);
+    std::fill(ay_.begin(), ay_.end(), 0.0);
+    sample_ = 0;
+    out_of_lane_ = 0.0;
+    speeding_ = accelerating_ = jerking_ = off_lane_ = false;
+
+    for (std::size_t i = 0; i < cars_.size(); i++)
+    {
+        // park the car out of the way, so it does not block the placement of the others
+        cars_[i].s = -1e9;
+        cars_[i].lane = -1;
+    }
+    // only ahead of the ego car: it starts standing, so a car behind it at full speed could not stop
+    // in time and would run into it before the planner gets a say
+    for (std::size_t i = 0; i < cars_.size(); i++)
+    {
+        spawn(cars_[i], ego_s_, ego_s_ + 250.0);
+    }
+}
+
+bool HighwaySimulator::laneFree(int lane, double s, double clearance, const Car *self) const
+{
+    double center = laneCenter(lane);
+    if (fabs(ego_d_ - center) < kLaneWidth * 0.75 && fabs(ego_s_ - s) < clearance)
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < cars_.size(); i++)
+    {
+        const Car &car = cars_[i];
+        if (&car == self)
+        {
+            continue;
+        }
+        bool in_lane = car.lane == lane || fabs(car.d - center) < kLaneWidth * 0.75;
+        if (in_lane && fabs(car.s - s) < clearance)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+void HighwaySimulator::spawn(Car &car, double s_lo, double s_hi)
+{
+    std::uniform_real_distribution<double> s_dist(s_lo, s_hi);
+    std::uniform_int_distribution<int> lane_dist(0, config_.num_lanes - 1);
+    std::uniform_real_distribution<double> speed_dist(config_.min_speed, config_.max_speed);
+
+    // a few attempts at a spot with room around it; crowded roads take the last one regardless
+    double s = s_lo;
+    int lane = 0;
+    for (int attempt = 0; attempt < 20; attempt++)
+    {
+        s = s_dist(rng_);
+        lane = lane_dist(rng_);
+        if (laneFree(lane, s, 25.0, &car))
+        {
+            break;
+        }
+    }
+    // a new identity, like a car entering the simulator's view
+    car.id = next_id_++;
+    car.s = s;
+    car.lane = lane;
+    car.d = laneCenter(lane);
+    car.desired_v = speed_dist(rng_);
+    car.v = car.desired_v;
+    car.from_d = car.d;
+    car.change_left = 0.0;
+    car.touching = false;
+}
+
+void HighwaySimulator::stepTraffic(double dt)
+{
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (std::size_t i = 0; i < cars_.size(); i++)
+    {
+        Car &car = cars_[i];
+
+        // closest vehicle ahead sharing the lane, the ego car included
+        double gap = 1e9;
+        double lead_v = car.v;
+        if (fabs(ego_d_ - car.d) < kLaneWidth * 0.6 && ego_s_ > car.s)
+        {
+            gap = ego_s_ - car.s - kCarLength;
+            lead_v = ego_speed_;
+        }
+        for (std::size_t j = 0; j < cars_.size(); j++)
+        {
+            const Car &other = cars_[j];
+            if (j == i || other.s <= car.s || fabs(other.d - car.d) >= kLaneWidth * 0.6)
+            {
+                continue;
+            }
+            if (other.s - car.s - kCarLength < gap)
+            {
+                gap = other.s - car.s - kCarLength;
+                lead_v = other.v;
+            }
+        }
+
+        double desired_gap = kIdmGap + car.v * kIdmHeadway +
+                car.v * (car.v - lead_v) / (2.0 * sqrt(kIdmAccel * kIdmBrake));
+        double free_road = pow(car.v / car.desired_v, 4);
+        double interaction = gap < 1e8 ? pow(std::max(desired_gap, 0.0) / std::max(gap, 0.1), 2) : 0.0;
+        double accel = kIdmAccel * (1.0 - free_road - interaction);
+        accel = std::max(-kHardestBrake, std::min(kIdmAccel, accel));
+        car.v = std::max(0.0, car.v + accel * dt);
+        car.s += car.v * dt;
+
+        if (car.change_left > 0.0)
+        {
+            car.change_left = std::max(0.0, car.change_left - dt);
+            double progress = 1.0 - car.change_left / config_.lane_change_time;
+            car.d = car.from_d + (laneCenter(car.lane) - car.from_d) * (0.5 - 0.5 * cos(M_PI * progress));
+        }
+        else if (unit(rng_) < config_.lane_change_rate * dt)
+        {
+            int target = car.lane + (unit(rng_) < 0.5 ? -1 : 1);
+            if (target >= 0 && target < config_.num_lanes && laneFree(target, car.s, 20.0, &car))
+            {
+                car.from_d = car.d;
+                car.lane = target;
+                car.change_left = config_.lane_change_time;
+            }
+        }
+
+        // keep the traffic around the ego car
+        if (car.s < ego_s_ - config_.behind)
+        {
+            spawn(car, ego_s_ + config_.ahead - 100.0, ego_s_ + config_.ahead);
+        }
+        else if (car.s > ego_s_ + config_.ahead)
+        {
+            spawn(car, ego_s_ - config_.behind, ego_s_ - config_.behind + 50.0);
+        }
+
+        bool touching = fabs(car.s - ego_s_) < kCarLength - 0.5 && fabs(car.d - ego_d_) < 2.0;
+        if (touching && !car.touching)
+        {
+            incident(metrics_.collisions);
+        }
+        car.touching = touching;
+    }
+}
+
+void HighwaySimulator::incident(int &counter)
+{
+    counter++;
+    if (metrics_.first_incident < 0)
+    {
+        metrics_.first_incident = metrics_.distance;
+    }
+}
+
+void HighwaySimulator::stepEgo(double x, double y)
+{
+    double dx = x - ego_x_;
+    double dy = y - ego_y_;
+    double step = sqrt(dx * dx + dy * dy);
+    if (step > 1e-6)
+    {
+        ego_yaw_ = atan2(dy, dx);
+    }
+    ego_x_ = x;
+    ego_y_ = y;
+    ego_speed_ = step / kDt;
+
+    double s, d;
+    toFrenet(ego_x_, ego_y_, ego_segment_, s, d);
+    // keep s unwrapped across the end of the track
+    double ds = wrapS(s, map_.max_s) - wrapS(ego_s_, map_.max_s);
+    if (ds < -map_.max_s / 2)
+    {
+        ds += map_.max_s;
+    }
+    else if (ds > map_.max_s / 2)
+    {
+        ds -= map_.max_s;
+    }
+    ego_s_ += ds;
+    ego_d_ = d;
+
+    metrics_.time += kDt;
+    metrics_.distance += step;
+
+    // velocity, .2 s averaged acceleration and jerk, in rings of kWindow + 1 samples
+    std::size_t now = sample_ % (kWindow + 1);
+    std::size_t before = (sample_ + 1) % (kWindow + 1);
+    std::size_t a_now = sample_ % (kJerkWindow + 1);
+    std::size_t a_before = (sample_ + 1) % (kJerkWindow + 1);
+    vx_[now] = dx / kDt;
+    vy_[now] = dy / kDt;
+    ax_[a_now] = (vx_[now] - vx_[before]) / (kWindow * kDt);
+    ay_[a_now] = (vy_[now] - vy_[before]) / (kWindow * kDt);
+    sample_++;
+    if (sample_ > kWindow)
+    {
+        double accel = sqrt(ax_[a_now] * ax_[a_now] + ay_[a_now] * ay_[a_now]);
+        metrics_.max_accel = std::max(metrics_.max_accel, accel);
+        bool over = accel > config_.max_accel;
+        if (over && !accelerating_)
+        {
+            metrics_.accel_violations++;
+        }
+        accelerating_ = over;
+    }
+    if (sample_ > kWindow + kJerkWindow)
+    {
+        double jx = (ax_[a_now] - ax_[a_before]) / (kJerkWindow * kDt);
+        double jy = (ay_[a_now] - ay_[a_before]) / (kJerkWindow * kDt);
+        double jerk = sqrt(jx * jx + jy * jy);
+        metrics_.max_jerk = std::max(metrics_.max_jerk, jerk);
+        bool over = jerk > config_.max_jerk;
+        if (over && !jerking_)
+        {
+            metrics_.jerk_violations++;
+        }
+        jerking_ = over;
+    }
+
+    double mph = ego_speed_ * 2.24;
+    metrics_.max_speed = std::max(metrics_.max_speed, mph);
+    bool speeding = mph > config_.speed_limit;
+    if (speeding && !speeding_)
+    {
+        incident(metrics_.speed_violations);
+    }
+    speeding_ = speeding;
+
+    // inside a lane means the whole 2 m wide car is between its lines
+    int lane = (int) floor(ego_d_ / kLaneWidth);
+    bool off_road = ego_d_ < 0.0 || ego_d_ > kLaneWidth * config_.num_lanes;
+    bool in_lane = !off_road && fabs(ego_d_ - laneCenter(lane)) < 1.0;
+    out_of_lane_ = in_lane ? 0.0 : out_of_lane_ + kDt;
+    bool off_lane = off_road || out_of_lane_ > config_.max_out_of_lane;
+    if (off_lane && !off_lane_)
+    {
+        incident(metrics_.lane_violations);
+    }
+    metrics_.off_lane_time += off_lane ? kDt : 0.0;
+    off_lane_ = off_lane;
+}
+
+void HighwaySimulator::telemetry(std::string &message)
+{
+    const int precision = 6;
+    message.clear();
+    message.append("42[\"telemetry\",{\"x\":");
+    appendNumber(ego_x_, precision, message);
+    message.append(",\"y\":");
+    appendNumber(ego_y_, precision, message);
+    message.append(",\"s\":");
+    appendNumber(wrapS(ego_s_, map_.max_s), precision, message);
+    message.append(",\"d\":");
+    appendNumber(ego_d_, precision, message);
+    message.append(",\"yaw\":");
+    appendNumber(rad2deg(ego_yaw_), precision, message);
+    message.append(",\"speed\":");
+    appendNumber(ego_speed_ * 2.24, precision, message);
+
+    message.append(",\"previous_path_x\":[");
+    for (std::size_t i = 0; i < remaining_.next_x.size(); i++)
+    {
+        if (i > 0)
+        {
+            message.push_back(',');
+        }
+        appendNumber(remaining_.next_x[i], precision, message);
+    }
+    message.append("],\"previous_path_y\":[");
+    for (std::size_t i = 0; i < remaining_.next_y.size(); i++)
+    {
+        if (i > 0)
+        {
+            message.push_back(',');
+        }
+        appendNumber(remaining_.next_y[i], precision, message);
+    }
+
+    double end_s = 0.0;
+    double end_d = 0.0;
+    if (!remaining_.next_x.empty())
+    {
+        std::size_t segment = ego_segment_;
+        toFrenet(remaining_.next_x.back(), remaining_.next_y.back(), segment, end_s, end_d);
+        end_s = wrapS(end_s, map_.max_s);
+    }
+    message.append("],\"end_path_s\":");
+    appendNumber(end_s, precision, message);
+    message.append(",\"end_path_d\":");
+    appendNumber(end_d, precision, message);
+
+    message.append(",\"sensor_fusion\":[");
+    for (std::size_t i = 0; i < cars_.size(); i++)
+    {
+        const Car &car = cars_[i];
+        double s = wrapS(car.s, map_.max_s);
+        std::vector<double> xy = getXY(s, car.d, map_.s, map_.x, map_.y);
+        std::vector<double> ahead = getXY(s + 1.0, car.d, map_.s, map_.x, map_.y);
+        double heading = atan2(ahead[1] - xy[1], ahead[0] - xy[0]);
+        if (i > 0)
+        {
+            message.push_back(',');
+        }
+        message.push_back('[');
+        appendNumber(car.id, 0, message);
+        message.push_back(',');
+        appendNumber(xy[0], precision, message);
+        message.push_back(',');
+        appendNumber(xy[1], precision, message);
+        message.push_back(',');
+        appendNumber(car.v * cos(heading), precision, message);
+        message.push_back(',');
+        appendNumber(car.v * sin(heading), precision, message);
+        message.push_back(',');
+        appendNumber(s, precision, message);
+        message.push_back(',');
+        appendNumber(car.d, precision, message);
+        message.push_back(']');
+    }
+    message.append("]}]");
+}
+
+bool HighwaySimulator::advance(const char *reply, std::size_t length)
+{
+    if (!parseControl(reply, length, path_))
+    {
+        return false;
+    }
+    advance(path_);
+    return true;
+}
+
+void HighwaySimulator::advance(const ControlFrame &path)
+{
+    // like the Unity simulator, a new path replaces whatever was left of the previous one
+    std::size_t driven = std::min(path.next_x.size(), (std::size_t) std::max(0, config_.points_per_step));
+    for (int i = 0; i < config_.points_per_step; i++)
+    {
+        if ((std::size_t) i < driven)
+        {
+            stepEgo(path.next_x[i], path.next_y[i]);
+        }
+        else
+        {
+            // out of path: the car stands still
+            stepEgo(ego_x_, ego_y_);
+        }
+        stepTraffic(kDt);
+    }
+    remaining_.next_x.assign(path.next_x.begin() + driven, path.next_x.end());
+    remaining_.next_y.assign(path.next_y.begin() + driven, path.next_y.end());
+    metrics_.steps++;
+}
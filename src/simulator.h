@@ -0,0 +1,137 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <cstddef>
+#include <random>
+#include <string>
+#include <vector>
+#include "control.h"
+#include "planner.h"
+
+struct SimulatorConfig
+{
+    // other cars kept around the ego car
+    int cars = 12;
+    unsigned seed = 1;
+    int num_lanes = 3;
+    // path points the ego car drives between two planner calls; the Unity simulator usually
+    // consumes one to three .02 s points while a reply is on its way
+    int points_per_step = 3;
+    // desired speeds of the other cars are drawn from [min_speed, max_speed] in m/s
+    double min_speed = 15.0;
+    double max_speed = 22.0;
+    // rate of spontaneous lane changes per car, per second
+    double lane_change_rate = 0.02;
+    // seconds a lane change of another car takes
+    double lane_change_time = 3.0;
+    // the other cars live within [ego_s - behind, ego_s + ahead] and respawn at the far end
+    double behind = 150.0;
+    double ahead = 400.0;
+    // the limits the Unity simulator grades a run against
+    double speed_limit = 50.0;      // mph
+    double max_accel = 10.0;        // m/s^2, averaged over .2 s
+    double max_jerk = 10.0;         // m/s^3, averaged over 1 s
+    double max_out_of_lane = 3.0;   // seconds between lanes
+};
+
+// What happened to the ego car during a run. Every violation counts once per episode of the
+// violation, not once per sample. Incidents are collisions, speeding and leaving the lane; going
+// over the acceleration or jerk limit is a comfort violation and counted apart.
+struct SimulatorMetrics
+{
+    unsigned long steps = 0;    // planner calls
+    double time = 0.0;          // simulated seconds
+    double distance = 0.0;      // metres driven by the ego car
+    int collisions = 0;
+    int speed_violations = 0;
+    int accel_violations = 0;
+    int jerk_violations = 0;
+    int lane_violations = 0;    // between lanes for too long or off the road
+    double off_lane_time = 0.0; // seconds spent in such a lane violation
+    double max_speed = 0.0;     // mph
+    double max_accel = 0.0;     // m/s^2, averaged over .2 s like the Unity simulator
+    double max_jerk = 0.0;      // m/s^3, the change of that acceleration averaged over 1 s
+    // distance at the first incident, negative while there has been none
+    double first_incident = -1.0;
+
+    int incidents() const { return collisions + speed_violations + lane_violations; }
+    int comfortViolations() const { return accel_violations + jerk_violations; }
+    double distanceWithoutIncident() const { return first_incident < 0 ? distance : first_incident; }
+    // m/s
+    double meanSpeed() const { return time > 0 ? distance / time : 0.0; }
+};
+
+// Headless stand-in for the Unity simulator. The ego car follows the planned path exactly, one
+// point every .02 s, and the other cars drive in Frenet coordinates with the intelligent driver
+// model plus random lane changes. Messages are produced and consumed in the simulator's SocketIO
+// format, so a run exercises the same parse, plan and serialize path as the websocket server.
+class HighwaySimulator
+{
+public:
+    HighwaySimulator(const HighwayMap &map, const SimulatorConfig &config);
+
+    // Start over at the simulator's spawn point with fresh traffic
+    void reset(unsigned seed);
+
+    // The telemetry message the simulator would send now
+    void telemetry(std::string &message);
+    // Take the planner's reply and drive the ego car along it for config.points_per_step points,
+    // moving the other cars with it. False if the reply is not a control message.
+    bool advance(const char *reply, std::size_t length);
+    // Same with the path already decoded
+    void advance(const ControlFrame &path);
+
+    const SimulatorMetrics &metrics() const { return metrics_; }
+    const SimulatorConfig &config() const { return config_; }
+
+    double egoS() const { return ego_s_; }
+    double egoD() const { return ego_d_; }
+    double egoSpeed() const { return ego_speed_; }
+
+private:
+    struct Car
+    {
+        int id;
+        double s;           // unwrapped, in the same frame as ego_s_
+        double d;
+        double v;
+        double desired_v;
+        int lane;
+        // lane change in progress: d moves from from_d to the center of lane over change_left s
+        double from_d;
+        double change_left;
+        bool touching;      // in contact with the ego car, to count every collision once
+    };
+
+    void spawn(Car &car, double s_lo, double s_hi);
+    bool laneFree(int lane, double s, double clearance, const Car *self) const;
+    void stepTraffic(double dt);
+    void stepEgo(double x, double y);
+    void incident(int &counter);
+    void toFrenet(double x, double y, std::size_t &segment, double &s, double &d) const;
+
+    const HighwayMap &map_;
+    SimulatorConfig config_;
+    std::mt19937 rng_;
+    int next_id_;
+
+    std::vector<Car> cars_;
+
+    // ego state: position, heading (rad), unwrapped Frenet s and d, speed in m/s
+    double ego_x_, ego_y_, ego_yaw_, ego_s_, ego_d_, ego_speed_;
+    // map segment the ego car is on, where the search for the next position starts
+    std::size_t ego_segment_;
+    // the part of the last path the ego car has not driven yet
+    ControlFrame remaining_;
+    ControlFrame path_;
+    // velocity samples of the last .2 s and acceleration samples of the last second, for the
+    // averaged accel and jerk
+    std::vector<double> vx_, vy_, ax_, ay_;
+    std::size_t sample_;
+    double out_of_lane_;
+    bool speeding_, accelerating_, jerking_, off_lane_;
+
+    SimulatorMetrics metrics_;
+};
+
+#endif // SIMULATOR_H
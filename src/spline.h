@@ -72,6 +72,11 @@ public:
     std::vector<double> l_solve(const std::vector<double>& b) const;
     std::vector<double> lu_solve(const std::vector<double>& b,
                                  bool is_lu_decomposed=false);
+    // same as above, into caller-owned vectors that keep their capacity
+    void r_solve(const std::vector<double>& b, std::vector<double>& x) const;
+    void l_solve(const std::vector<double>& b, std::vector<double>& x) const;
+    void lu_solve(const std::vector<double>& b, std::vector<double>& x,
+                  std::vector<double>& y, bool is_lu_decomposed=false);
 
 };
 
@@ -94,6 +99,10 @@ private:
     bd_type m_left, m_right;
     double  m_left_value, m_right_value;
     bool    m_force_linear_extrapolation;
+    // equation system of set_points(), kept so that setting the points
+    // of the same spline again does not allocate
+    band_matrix m_A;
+    std::vector<double> m_rhs, m_tmp;
 
 public:
     // set default boundary condition to be zero curvature at both ends
@@ -110,6 +119,9 @@ public:
                       bool force_linear_extrapolation=false);
     void set_points(const std::vector<double>& x,
                     const std::vector<double>& y, bool cubic_spline=true);
+    // same for n points in caller-owned arrays
+    void set_points(const double* x, const double* y, int n,
+                    bool cubic_spline=true);
     double operator() (double x) const;
 };
 
@@ -123,7 +135,7 @@ public:
 // band_matrix implementation
 // -------------------------
 
-band_matrix::band_matrix(int dim, int n_u, int n_l)
+inline band_matrix::band_matrix(int dim, int n_u, int n_l)
 {
     resize(dim, n_u, n_l);
 }
@@ -135,10 +147,10 @@ void band_matrix::resize(int dim, int n_u, int n_l)
     m_upper.resize(n_u+1);
     m_lower.resize(n_l+1);
     for(size_t i=0; i<m_upper.size(); i++) {
-        m_upper[i].resize(dim);
+        m_upper[i].assign(dim, 0.0);
     }
     for(size_t i=0; i<m_lower.size(); i++) {
-        m_lower[i].resize(dim);
+        m_lower[i].assign(dim, 0.0);
     }
 }
 int band_matrix::dim() const
@@ -220,9 +232,15 @@ void band_matrix::lu_decompose()
 }
 // solves Ly=b
 std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
+{
+    std::vector<double> x;
+    l_solve(b, x);
+    return x;
+}
+void band_matrix::l_solve(const std::vector<double>& b, std::vector<double>& x) const
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
+    x.resize(this->dim());
     int j_start;
     double sum;
     for(int i=0; i<this->dim(); i++) {
@@ -231,13 +249,18 @@ std::vector<double> band_matrix::l_solve(const std::vector<double>& b) const
         for(int j=j_start; j<i; j++) sum += this->operator()(i,j)*x[j];
         x[i]=(b[i]*this->saved_diag(i)) - sum;
     }
-    return x;
 }
 // solves Rx=y
 std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
+{
+    std::vector<double> x;
+    r_solve(b, x);
+    return x;
+}
+void band_matrix::r_solve(const std::vector<double>& b, std::vector<double>& x) const
 {
     assert( this->dim()==(int)b.size() );
-    std::vector<double> x(this->dim());
+    x.resize(this->dim());
     int j_stop;
     double sum;
     for(int i=this->dim()-1; i>=0; i--) {
@@ -246,10 +269,9 @@ std::vector<double> band_matrix::r_solve(const std::vector<double>& b) const
         for(int j=i+1; j<=j_stop; j++) sum += this->operator()(i,j)*x[j];
         x[i]=( b[i] - sum ) / this->operator()(i,i);
     }
-    return x;
 }
 
-std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
+inline std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
         bool is_lu_decomposed)
 {
     assert( this->dim()==(int)b.size() );
@@ -261,6 +283,16 @@ std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
     x=this->r_solve(y);
     return x;
 }
+void band_matrix::lu_solve(const std::vector<double>& b, std::vector<double>& x,
+                           std::vector<double>& y, bool is_lu_decomposed)
+{
+    assert( this->dim()==(int)b.size() );
+    if(is_lu_decomposed==false) {
+        this->lu_decompose();
+    }
+    this->l_solve(b, y);
+    this->r_solve(y, x);
+}
 
 
 
@@ -268,9 +300,9 @@ std::vector<double> band_matrix::lu_solve(const std::vector<double>& b,
 // spline implementation
 // -----------------------
 
-void spline::set_boundary(spline::bd_type left, double left_value,
-                          spline::bd_type right, double right_value,
-                          bool force_linear_extrapolation)
+inline void spline::set_boundary(spline::bd_type left, double left_value,
+                                 spline::bd_type right, double right_value,
+                                 bool force_linear_extrapolation)
 {
     assert(m_x.size()==0);          // set_points() must not have happened yet
     m_left=left;
@@ -281,14 +313,19 @@ void spline::set_boundary(spline::bd_type left, double left_value,
 }
 
 
-void spline::set_points(const std::vector<double>& x,
-                        const std::vector<double>& y, bool cubic_spline)
+inline void spline::set_points(const std::vector<double>& x,
+                               const std::vector<double>& y, bool cubic_spline)
 {
     assert(x.size()==y.size());
-    assert(x.size()>2);
-    m_x=x;
-    m_y=y;
-    int   n=x.size();
+    set_points(x.data(), y.data(), (int) x.size(), cubic_spline);
+}
+
+void spline::set_points(const double* x, const double* y, int n,
+                        bool cubic_spline)
+{
+    assert(n>2);
+    m_x.assign(x, x+n);
+    m_y.assign(y, y+n);
     // TODO: maybe sort x and y, rather than returning an error
     for(int i=0; i<n-1; i++) {
         assert(m_x[i]<m_x[i+1]);
@@ -297,8 +334,10 @@ void spline::set_points(const std::vector<double>& x,
     if(cubic_spline==true) { // cubic spline interpolation
         // setting up the matrix and right hand side of the equation system
         // for the parameters b[]
-        band_matrix A(n,1,1);
-        std::vector<double>  rhs(n);
+        band_matrix& A=m_A;
+        std::vector<double>& rhs=m_rhs;
+        A.resize(n,1,1);
+        rhs.assign(n, 0.0);
         for(int i=1; i<n-1; i++) {
             A(i,i-1)=1.0/3.0*(x[i]-x[i-1]);
             A(i,i)=2.0/3.0*(x[i+1]-x[i-1]);
@@ -337,7 +376,7 @@ void spline::set_points(const std::vector<double>& x,
         }
 
         // solve the equation system to obtain the parameters b[]
-        m_b=A.lu_solve(rhs);
+        A.lu_solve(rhs, m_b, m_tmp);
 
         // calculate parameters a[] and c[] based on b[]
         m_a.resize(n);
@@ -0,0 +1,154 @@
+#include "stage_timer.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+
+namespace
+{
+
+const int kStages = (int) PlannerStage::kCount;
+
+struct StageHistograms
+{
+    LatencyHistogram stages[kStages];
+};
+
+// Every thread's histograms, for the readers; a thread only takes the lock to add its own set
+struct StageRegistry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<StageHistograms>> threads;
+};
+
+StageRegistry &registry()
+{
+    // never destroyed, so threads still running at exit can keep recording
+    static StageRegistry *instance = new StageRegistry;
+    return *instance;
+}
+
+StageHistograms &threadHistograms()
+{
+    thread_local StageHistograms *histograms = nullptr;
+    if (histograms == nullptr)
+    {
+        std::unique_ptr<StageHistograms> created(new StageHistograms);
+        histograms = created.get();
+        StageRegistry &r = registry();
+        std::lock_guard<std::mutex> lock(r.mutex);
+        r.threads.push_back(std::move(created));
+    }
+    return *histograms;
+}
+
+// value at quantile q of the merged counts
+double quantile(const std::vector<uint64_t> &counts, uint64_t total, double q)
+{
+    uint64_t rank = (uint64_t) (q * (total - 1)) + 1;
+    uint64_t seen = 0;
+    for (int b = 0; b < LatencyHistogram::kBuckets; b++)
+    {
+        seen += counts[b];
+        if (seen >= rank)
+        {
+            return LatencyHistogram::bucketValue(b);
+        }
+    }
+    return LatencyHistogram::bucketValue(LatencyHistogram::kBuckets - 1);
+}
+
+}  // namespace
+
+const char *stageName(PlannerStage stage)
+{
+    switch (stage)
+    {
+        case PlannerStage::kParse: return "parse";
+        case PlannerStage::kPredict: return "predict";
+        case PlannerStage::kDetect: return "detect";
+        case PlannerStage::kCost: return "cost";
+        case PlannerStage::kGenerate: return "generate";
+        case PlannerStage::kSerialize: return "serialize";
+        case PlannerStage::kFrame: return "frame";
+        default: return "unknown";
+    }
+}
+
+LatencyHistogram::LatencyHistogram() : total_(0), sum_(0), max_(0)
+{
+    for (int b = 0; b < kBuckets; b++)
+    {
+        counts_[b].store(0, std::memory_order_relaxed);
+    }
+}
+
+double LatencyHistogram::bucketValue(int bucket)
+{
+    if (bucket < (1 << kSubBits))
+    {
+        return bucket;
+    }
+    int shift = (bucket >> (kSubBits - 1)) - 1;
+    uint64_t low = (uint64_t) (bucket - (shift << (kSubBits - 1))) << shift;
+    return low + ((1ull << shift) - 1) / 2.0;
+}
+
+void recordStage(PlannerStage stage, uint64_t ns)
+{
+    threadHistograms().stages[(int) stage].record(ns);
+}
+
+void stageLatencies(std::vector<StageLatency> &latencies)
+{
+    latencies.assign(kStages, StageLatency());
+    std::vector<uint64_t> counts(LatencyHistogram::kBuckets);
+    StageRegistry &r = registry();
+    std::lock_guard<std::mutex> lock(r.mutex);
+    for (int s = 0; s < kStages; s++)
+    {
+        StageLatency &latency = latencies[s];
+        latency.stage = (PlannerStage) s;
+        std::fill(counts.begin(), counts.end(), 0);
+        uint64_t sum = 0;
+        uint64_t max = 0;
+        for (std::size_t t = 0; t < r.threads.size(); t++)
+        {
+            const LatencyHistogram &h = r.threads[t]->stages[s];
+            for (int b = 0; b < LatencyHistogram::kBuckets; b++)
+            {
+                uint64_t count = h.count(b);
+                counts[b] += count;
+                latency.count += count;
+            }
+            sum += h.sum();
+            max = std::max(max, h.max());
+        }
+        if (latency.count == 0)
+        {
+            continue;
+        }
+        latency.mean_us = sum / 1000.0 / latency.count;
+        latency.p50_us = quantile(counts, latency.count, 0.5) / 1000.0;
+        latency.p99_us = quantile(counts, latency.count, 0.99) / 1000.0;
+        latency.p999_us = quantile(counts, latency.count, 0.999) / 1000.0;
+        latency.max_us = max / 1000.0;
+    }
+}
+
+void printStageReport(std::ostream &out)
+{
+    std::vector<StageLatency> latencies;
+    stageLatencies(latencies);
+    char line[160];
+    snprintf(line, sizeof(line), "%-10s %10s %9s %9s %9s %9s %9s\n", "stage us", "count", "mean", "p50", "p99",
+            "p99.9", "max");
+    out << line;
+    for (std::size_t s = 0; s < latencies.size(); s++)
+    {
+        const StageLatency &l = latencies[s];
+        snprintf(line, sizeof(line), "%-10s %10llu %9.2f %9.2f %9.2f %9.2f %9.2f\n", stageName(l.stage),
+                (unsigned long long) l.count, l.mean_us, l.p50_us, l.p99_us, l.p999_us, l.max_us);
+        out << line;
+    }
+}
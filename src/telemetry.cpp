@@ -0,0 +1,392 @@
+#include "telemetry.h"
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+namespace
+{
+
+// Read position in the message; never reads at or past end
+struct Cursor
+{
+    const char *p;
+    const char *end;
+};
+
+void skipSpace(Cursor &c)
+{
+    while (c.p < c.end && (*c.p == ' ' || *c.p == '\n' || *c.p == '\r' || *c.p == '\t'))
+    {
+        c.p++;
+    }
+}
+
+bool expect(Cursor &c, char ch)
+{
+    skipSpace(c);
+    if (c.p < c.end && *c.p == ch)
+    {
+        c.p++;
+        return true;
+    }
+    return false;
+}
+
+// Consume ch if it is the next non-blank character
+bool accept(Cursor &c, char ch)
+{
+    return expect(c, ch);
+}
+
+bool acceptLiteral(Cursor &c, const char *literal)
+{
+    skipSpace(c);
+    std::size_t n = std::strlen(literal);
+    if ((std::size_t) (c.end - c.p) >= n && std::memcmp(c.p, literal, n) == 0)
+    {
+        c.p += n;
+        return true;
+    }
+    return false;
+}
+
+// Parse a string without escapes, returning a view of its contents
+bool parseString(Cursor &c, const char *&begin, std::size_t &length)
+{
+    if (!expect(c, '"'))
+    {
+        return false;
+    }
+    begin = c.p;
+    while (c.p < c.end && *c.p != '"')
+    {
+        if (*c.p == '\\')
+        {
+            // escaped character, never part of the keys we look for
+            c.p++;
+        }
+        c.p++;
+    }
+    if (c.p >= c.end)
+    {
+        return false;
+    }
+    length = c.p - begin;
+    c.p++;
+    return true;
+}
+
+// Exact powers of ten representable as doubles
+const double kPow10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                         1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+// Parse a JSON number. Numbers whose digits fit in 53 bits with a power of ten up to 1e22 are
+// converted exactly with one multiplication or division (Clinger's fast path); anything else goes
+// through strtod on a bounded copy.
+bool parseNumber(Cursor &c, double &value)
+{
+    skipSpace(c);
+    const char *start = c.p;
+    bool negative = false;
+    if (c.p < c.end && *c.p == '-')
+    {
+        negative = true;
+        c.p++;
+    }
+    std::uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    while (c.p < c.end && *c.p >= '0' && *c.p <= '9')
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*c.p - '0');
+            if (mantissa != 0)
+            {
+                digits++;
+            }
+        }
+        else
+        {
+            exponent++;
+        }
+        any = true;
+        c.p++;
+    }
+    if (c.p < c.end && *c.p == '.')
+    {
+        c.p++;
+        while (c.p < c.end && *c.p >= '0' && *c.p <= '9')
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*c.p - '0');
+                if (mantissa != 0)
+                {
+                    digits++;
+                }
+                exponent--;
+            }
+            any = true;
+            c.p++;
+        }
+    }
+    if (!any)
+    {
+        return false;
+    }
+    if (c.p < c.end && (*c.p == 'e' || *c.p == 'E'))
+    {
+        c.p++;
+        bool exp_negative = false;
+        if (c.p < c.end && (*c.p == '-' || *c.p == '+'))
+        {
+            exp_negative = *c.p == '-';
+            c.p++;
+        }
+        int e = 0;
+        bool exp_any = false;
+        while (c.p < c.end && *c.p >= '0' && *c.p <= '9')
+        {
+            if (e < 10000)
+            {
+                e = e * 10 + (*c.p - '0');
+            }
+            exp_any = true;
+            c.p++;
+        }
+        if (!exp_any)
+        {
+            return false;
+        }
+        exponent += exp_negative ? -e : e;
+    }
+
+    if (digits < 19 && mantissa <= (1ULL << 53) && exponent >= -22 && exponent <= 22)
+    {
+        double m = (double) mantissa;
+        value = exponent >= 0 ? m * kPow10[exponent] : m / kPow10[-exponent];
+        if (negative)
+        {
+            value = -value;
+        }
+        return true;
+    }
+
+    char buffer[64];
+    std::size_t length = c.p - start;
+    if (length >= sizeof(buffer))
+    {
+        return false;
+    }
+    std::memcpy(buffer, start, length);
+    buffer[length] = '\0';
+    value = std::strtod(buffer, nullptr);
+    return true;
+}
+
+// Skip over any JSON value
+bool skipValue(Cursor &c, int depth = 0)
+{
+    skipSpace(c);
+    if (c.p >= c.end || depth > 32)
+    {
+        return false;
+    }
+    if (*c.p == '"')
+    {
+        const char *begin;
+        std::size_t length;
+        return parseString(c, begin, length);
+    }
+    if (*c.p == '[' || *c.p == '{')
+    {
+        char close = (*c.p == '[') ? ']' : '}';
+        bool object = *c.p == '{';
+        c.p++;
+        if (accept(c, close))
+        {
+            return true;
+        }
+        do
+        {
+            if (object)
+            {
+                const char *begin;
+                std::size_t length;
+                if (!parseString(c, begin, length) || !expect(c, ':'))
+                {
+                    return false;
+                }
+            }
+            if (!skipValue(c, depth + 1))
+            {
+                return false;
+            }
+        } while (accept(c, ','));
+        return expect(c, close);
+    }
+    if (acceptLiteral(c, "true") || acceptLiteral(c, "false") || acceptLiteral(c, "null"))
+    {
+        return true;
+    }
+    double ignored;
+    return parseNumber(c, ignored);
+}
+
+// [n, n, ...] appended to out
+bool parseNumberArray(Cursor &c, std::vector<double> &out)
+{
+    out.clear();
+    if (!expect(c, '['))
+    {
+        return false;
+    }
+    if (accept(c, ']'))
+    {
+        return true;
+    }
+    do
+    {
+        double value;
+        if (!parseNumber(c, value))
+        {
+            return false;
+        }
+        out.push_back(value);
+    } while (accept(c, ','));
+    return expect(c, ']');
+}
+
+// [[id, x, y, vx, vy, s, d], ...]
+bool parseSensorFusion(Cursor &c, SensorFusionFrame &sensor_fusion)
+{
+    sensor_fusion.clear();
+    if (!expect(c, '['))
+    {
+        return false;
+    }
+    if (accept(c, ']'))
+    {
+        return true;
+    }
+    do
+    {
+        double car[7];
+        if (!expect(c, '['))
+        {
+            return false;
+        }
+        for (int k = 0; k < 7; k++)
+        {
+            if ((k > 0 && !expect(c, ',')) || !parseNumber(c, car[k]))
+            {
+                return false;
+            }
+        }
+        // tolerate extra attributes after the seven we know about
+        while (accept(c, ','))
+        {
+            if (!skipValue(c))
+            {
+                return false;
+            }
+        }
+        if (!expect(c, ']'))
+        {
+            return false;
+        }
+        sensor_fusion.push_back((int) car[0], car[1], car[2], car[3], car[4], car[5], car[6]);
+    } while (accept(c, ','));
+    return expect(c, ']');
+}
+
+bool keyIs(const char *key, std::size_t length, const char *name)
+{
+    return std::strlen(name) == length && std::memcmp(key, name, length) == 0;
+}
+
+// {"x":..., "y":..., ...} into the frame fields
+bool parseTelemetryObject(Cursor &c, TelemetryFrame &frame)
+{
+    frame.previous_path_x.clear();
+    frame.previous_path_y.clear();
+    frame.sensor_fusion.clear();
+    if (!expect(c, '{'))
+    {
+        return false;
+    }
+    if (accept(c, '}'))
+    {
+        return true;
+    }
+    do
+    {
+        const char *key;
+        std::size_t length;
+        if (!parseString(c, key, length) || !expect(c, ':'))
+        {
+            return false;
+        }
+
+        bool ok;
+        if (keyIs(key, length, "x")) ok = parseNumber(c, frame.car_x);
+        else if (keyIs(key, length, "y")) ok = parseNumber(c, frame.car_y);
+        else if (keyIs(key, length, "s")) ok = parseNumber(c, frame.car_s);
+        else if (keyIs(key, length, "d")) ok = parseNumber(c, frame.car_d);
+        else if (keyIs(key, length, "yaw")) ok = parseNumber(c, frame.car_yaw);
+        else if (keyIs(key, length, "speed")) ok = parseNumber(c, frame.car_speed);
+        else if (keyIs(key, length, "previous_path_x")) ok = parseNumberArray(c, frame.previous_path_x);
+        else if (keyIs(key, length, "previous_path_y")) ok = parseNumberArray(c, frame.previous_path_y);
+        else if (keyIs(key, length, "end_path_s")) ok = parseNumber(c, frame.end_path_s);
+        else if (keyIs(key, length, "end_path_d")) ok = parseNumber(c, frame.end_path_d);
+        else if (keyIs(key, length, "sensor_fusion")) ok = parseSensorFusion(c, frame.sensor_fusion);
+        else ok = skipValue(c);
+
+        if (!ok)
+        {
+            return false;
+        }
+    } while (accept(c, ','));
+
+    // both halves of the previous path have to line up
+    if (frame.previous_path_x.size() != frame.previous_path_y.size())
+    {
+        return false;
+    }
+    return expect(c, '}');
+}
+
+}  // namespace
+
+MessageType parseTelemetry(const char *data, std::size_t length, TelemetryFrame &frame)
+{
+    // "42" at the start of the message means there's a websocket message event.
+    if (length <= 2 || data[0] != '4' || data[1] != '2')
+    {
+        return MessageType::kInvalid;
+    }
+    Cursor c = {data + 2, data + length};
+
+    const char *event;
+    std::size_t event_length;
+    if (!expect(c, '[') || !parseString(c, event, event_length))
+    {
+        return MessageType::kInvalid;
+    }
+    // an event without a data object means manual driving
+    if (!accept(c, ',') || acceptLiteral(c, "null"))
+    {
+        return MessageType::kManual;
+    }
+    if (!keyIs(event, event_length, "telemetry"))
+    {
+        return MessageType::kOther;
+    }
+    if (!parseTelemetryObject(c, frame))
+    {
+        return MessageType::kInvalid;
+    }
+    return MessageType::kTelemetry;
+}
@@ -0,0 +1,51 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <cstddef>
+#include <vector>
+#include "sensor_fusion.h"
+
+// One telemetry message from the simulator. The vectors are reused from frame to frame, so a frame
+// that is parsed into over and over stops allocating once it has seen the largest message.
+struct TelemetryFrame
+{
+    // Main car's localization Data
+    double car_x = 0.0;
+    double car_y = 0.0;
+    double car_s = 0.0;
+    double car_d = 0.0;
+    double car_yaw = 0.0;       // [deg]
+    double car_speed = 0.0;     // [mph]
+
+    // Previous path data given to the Planner
+    std::vector<double> previous_path_x;
+    std::vector<double> previous_path_y;
+    // Previous path's end s and d values
+    double end_path_s = 0.0;
+    double end_path_d = 0.0;
+
+    // Sensor Fusion Data, a list of all other cars on the same side of the road.
+    SensorFusionFrame sensor_fusion;
+
+    void reserve(std::size_t path_points, std::size_t vehicles)
+    {
+        previous_path_x.reserve(path_points);
+        previous_path_y.reserve(path_points);
+        sensor_fusion.reserve(vehicles);
+    }
+};
+
+// What a SocketIO message turned out to be
+enum class MessageType
+{
+    kInvalid,       // not a "42" event, or malformed
+    kManual,        // event without data: the simulator is in manual mode
+    kTelemetry,     // telemetry event, frame filled in
+    kOther          // some other event with data
+};
+
+// Parse a SocketIO message of the form 42["telemetry",{...}] straight from the websocket buffer
+// into frame, without building a JSON document. data does not need to be null-terminated.
+MessageType parseTelemetry(const char *data, std::size_t length, TelemetryFrame &frame);
+
+#endif // TELEMETRY_H
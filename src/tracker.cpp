@@ -0,0 +1,347 @@
+#include "tracker.h"
+#include <math.h>
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+
+std::size_t nextPowerOfTwo(std::size_t n)
+{
+    std::size_t p = 1;
+    while (p < n)
+    {
+        p <<= 1;
+    }
+    return p;
+}
+
+// integer hash (finalizer of murmur3), spreads consecutive ids over the table
+std::size_t hashId(int id)
+{
+    std::uint32_t h = (std::uint32_t) id;
+    h ^= h >> 16;
+    h *= 0x85ebca6bu;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35u;
+    h ^= h >> 16;
+    return h;
+}
+
+}  // namespace
+
+VehicleTracker::VehicleTracker(std::size_t max_tracks, double max_s)
+    : max_tracks_(max_tracks), count_(0), deleted_(0), frame_(0), max_s_(max_s)
+{
+    // keep the load factor at or below 1/2
+    std::size_t capacity = nextPowerOfTwo(2 * (max_tracks > 0 ? max_tracks : 1));
+    mask_ = capacity - 1;
+    slots_.resize(capacity);
+    state_.assign(capacity, kEmpty);
+    rehash_slots_.resize(capacity);
+    rehash_state_.assign(capacity, kEmpty);
+    speed_.reserve(max_tracks);
+    accel_.reserve(max_tracks);
+    lateral_v_.reserve(max_tracks);
+}
+
+void VehicleTracker::clear()
+{
+    std::fill(state_.begin(), state_.end(), (std::uint8_t) kEmpty);
+    count_ = 0;
+    deleted_ = 0;
+    speed_.clear();
+    accel_.clear();
+    lateral_v_.clear();
+}
+
+// Slot holding id, or the table size if the id is not present
+std::size_t VehicleTracker::slotFor(int id) const
+{
+    std::size_t i = hashId(id) & mask_;
+    for (std::size_t probe = 0; probe <= mask_; probe++)
+    {
+        if (state_[i] == kEmpty)
+        {
+            break;
+        }
+        if (state_[i] == kUsed && slots_[i].id == id)
+        {
+            return i;
+        }
+        i = (i + 1) & mask_;
+    }
+    return slots_.size();
+}
+
+const Track *VehicleTracker::find(int id) const
+{
+    std::size_t i = slotFor(id);
+    return i < slots_.size() ? &slots_[i] : nullptr;
+}
+
+// Claim a slot for a new id, reusing the first deleted slot on the probe sequence
+Track *VehicleTracker::insert(int id)
+{
+    if (count_ >= max_tracks_)
+    {
+        return nullptr;
+    }
+    std::size_t i = hashId(id) & mask_;
+    while (state_[i] == kUsed)
+    {
+        i = (i + 1) & mask_;
+    }
+    if (state_[i] == kDeleted)
+    {
+        deleted_--;
+    }
+    state_[i] = kUsed;
+    count_++;
+    return &slots_[i];
+}
+
+void VehicleTracker::initTrack(Track &track, int id, double s, double v, double d) const
+{
+    track.id = id;
+    track.s = s;
+    track.v = v;
+    track.a = 0.0;
+    track.d = d;
+    track.vd = 0.0;
+    std::memset(track.P, 0, sizeof(track.P));
+    std::memset(track.Pd, 0, sizeof(track.Pd));
+    track.P[0][0] = sigma_s * sigma_s;
+    track.P[1][1] = sigma_v * sigma_v;
+    track.P[2][2] = 4.0;
+    track.Pd[0][0] = sigma_d * sigma_d;
+    track.Pd[1][1] = 1.0;
+    track.age = 1;
+    track.last_seen = frame_;
+}
+
+// Time update of both filters: x = F x, P = F P F' + Q
+void VehicleTracker::predict(Track &track, double dt) const
+{
+    if (dt <= 0.0)
+    {
+        return;
+    }
+    double dt2 = dt * dt;
+    double dt3 = dt2 * dt;
+
+    // longitudinal constant-acceleration model
+    track.s += track.v * dt + 0.5 * track.a * dt2;
+    track.v += track.a * dt;
+    if (track.s >= max_s_)
+    {
+        track.s -= max_s_;
+    }
+
+    const double F[3][3] = {{1.0, dt, 0.5 * dt2}, {0.0, 1.0, dt}, {0.0, 0.0, 1.0}};
+    double FP[3][3];
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            FP[r][c] = F[r][0] * track.P[0][c] + F[r][1] * track.P[1][c] + F[r][2] * track.P[2][c];
+        }
+    }
+    for (int r = 0; r < 3; r++)
+    {
+        for (int c = 0; c < 3; c++)
+        {
+            track.P[r][c] = FP[r][0] * F[c][0] + FP[r][1] * F[c][1] + FP[r][2] * F[c][2];
+        }
+    }
+    // discrete white-jerk process noise
+    double q = q_jerk;
+    track.P[0][0] += q * dt3 * dt2 / 20.0;
+    track.P[0][1] += q * dt2 * dt2 / 8.0;
+    track.P[0][2] += q * dt3 / 6.0;
+    track.P[1][0] += q * dt2 * dt2 / 8.0;
+    track.P[1][1] += q * dt3 / 3.0;
+    track.P[1][2] += q * dt2 / 2.0;
+    track.P[2][0] += q * dt3 / 6.0;
+    track.P[2][1] += q * dt2 / 2.0;
+    track.P[2][2] += q * dt;
+
+    // lateral constant-velocity model
+    track.d += track.vd * dt;
+    double p00 = track.Pd[0][0] + dt * (track.Pd[1][0] + track.Pd[0][1]) + dt2 * track.Pd[1][1];
+    double p01 = track.Pd[0][1] + dt * track.Pd[1][1];
+    double p11 = track.Pd[1][1];
+    double ql = q_lateral;
+    track.Pd[0][0] = p00 + ql * dt3 / 3.0;
+    track.Pd[0][1] = p01 + ql * dt2 / 2.0;
+    track.Pd[1][0] = track.Pd[0][1];
+    track.Pd[1][1] = p11 + ql * dt;
+}
+
+// Measurement update: z = [s, v] for the longitudinal filter, z = d for the lateral one
+void VehicleTracker::correct(Track &track, double s, double v, double d) const
+{
+    // innovation, with s wrapped around the end of the track
+    double ys = s - track.s;
+    if (ys > 0.5 * max_s_)
+    {
+        ys -= max_s_;
+    }
+    else if (ys < -0.5 * max_s_)
+    {
+        ys += max_s_;
+    }
+    double yv = v - track.v;
+
+    // S = H P H' + R, with H selecting the first two states
+    double s00 = track.P[0][0] + sigma_s * sigma_s;
+    double s01 = track.P[0][1];
+    double s10 = track.P[1][0];
+    double s11 = track.P[1][1] + sigma_v * sigma_v;
+    double det = s00 * s11 - s01 * s10;
+    if (fabs(det) > 1e-12)
+    {
+        double i00 = s11 / det;
+        double i01 = -s01 / det;
+        double i10 = -s10 / det;
+        double i11 = s00 / det;
+
+        // K = P H' S^-1 (3x2)
+        double K[3][2];
+        for (int r = 0; r < 3; r++)
+        {
+            K[r][0] = track.P[r][0] * i00 + track.P[r][1] * i10;
+            K[r][1] = track.P[r][0] * i01 + track.P[r][1] * i11;
+        }
+        track.s += K[0][0] * ys + K[0][1] * yv;
+        track.v += K[1][0] * ys + K[1][1] * yv;
+        track.a += K[2][0] * ys + K[2][1] * yv;
+
+        // P = (I - K H) P
+        double P[3][3];
+        for (int r = 0; r < 3; r++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                P[r][c] = track.P[r][c] - K[r][0] * track.P[0][c] - K[r][1] * track.P[1][c];
+            }
+        }
+        std::memcpy(&track.P[0][0], &P[0][0], sizeof(P));
+    }
+    if (track.s < 0.0)
+    {
+        track.s += max_s_;
+    }
+    else if (track.s >= max_s_)
+    {
+        track.s -= max_s_;
+    }
+
+    // lateral filter, scalar measurement
+    double yd = d - track.d;
+    double sd = track.Pd[0][0] + sigma_d * sigma_d;
+    double k0 = track.Pd[0][0] / sd;
+    double k1 = track.Pd[1][0] / sd;
+    track.d += k0 * yd;
+    track.vd += k1 * yd;
+    double p00 = track.Pd[0][0] - k0 * track.Pd[0][0];
+    double p01 = track.Pd[0][1] - k0 * track.Pd[0][1];
+    double p11 = track.Pd[1][1] - k1 * track.Pd[0][1];
+    track.Pd[0][0] = p00;
+    track.Pd[0][1] = p01;
+    track.Pd[1][0] = p01;
+    track.Pd[1][1] = p11;
+}
+
+void VehicleTracker::update(const SensorFusionFrame &sensor_fusion, double dt)
+{
+    frame_++;
+    std::size_t n = sensor_fusion.size();
+    speed_.resize(n);
+    accel_.resize(n);
+    lateral_v_.resize(n);
+
+    for (std::size_t i = 0; i < n; i++)
+    {
+        int id = sensor_fusion.id[i];
+        double vx = sensor_fusion.vx[i];
+        double vy = sensor_fusion.vy[i];
+        double v = sqrt(vx * vx + vy * vy);
+        double s = sensor_fusion.s[i];
+        double d = sensor_fusion.d[i];
+
+        Track *track = nullptr;
+        std::size_t slot = slotFor(id);
+        if (slot < slots_.size())
+        {
+            track = &slots_[slot];
+            // a track that missed frames is propagated over the whole gap
+            predict(*track, dt * (double) (frame_ - track->last_seen));
+            correct(*track, s, v, d);
+            track->age++;
+            track->last_seen = frame_;
+        }
+        else if ((track = insert(id)) != nullptr)
+        {
+            initTrack(*track, id, s, v, d);
+        }
+
+        if (track != nullptr)
+        {
+            speed_[i] = track->v;
+            accel_[i] = track->a;
+            lateral_v_[i] = track->vd;
+        }
+        else
+        {
+            // table full: pass the raw measurement through
+            speed_[i] = v;
+            accel_[i] = 0.0;
+            lateral_v_[i] = 0.0;
+        }
+    }
+
+    evictStale();
+}
+
+// Drop the tracks that have not been measured for max_missed_frames frames
+void VehicleTracker::evictStale()
+{
+    for (std::size_t i = 0; i < slots_.size(); i++)
+    {
+        if (state_[i] == kUsed && frame_ - slots_[i].last_seen > max_missed_frames)
+        {
+            state_[i] = kDeleted;
+            count_--;
+            deleted_++;
+        }
+    }
+    // tombstones lengthen every probe sequence; rebuild the table once they pile up
+    if (deleted_ > (mask_ + 1) / 4)
+    {
+        rehash();
+    }
+}
+
+// Reinsert the live tracks into the spare table and swap, without allocating
+void VehicleTracker::rehash()
+{
+    std::fill(rehash_state_.begin(), rehash_state_.end(), (std::uint8_t) kEmpty);
+    for (std::size_t i = 0; i < slots_.size(); i++)
+    {
+        if (state_[i] != kUsed)
+        {
+            continue;
+        }
+        std::size_t j = hashId(slots_[i].id) & mask_;
+        while (rehash_state_[j] == kUsed)
+        {
+            j = (j + 1) & mask_;
+        }
+        rehash_slots_[j] = slots_[i];
+        rehash_state_[j] = kUsed;
+    }
+    slots_.swap(rehash_slots_);
+    state_.swap(rehash_state_);
+    deleted_ = 0;
+}
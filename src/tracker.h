@@ -0,0 +1,90 @@
+#ifndef TRACKER_H
+#define TRACKER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "sensor_fusion.h"
+
+// Filtered state of one vehicle, kept across frames under its sensor fusion id.
+// Longitudinal motion uses a constant-acceleration Kalman filter over [s, v, a] fed with the
+// measured s and speed; lateral motion uses a constant-velocity filter over [d, vd] fed with d.
+struct Track
+{
+    int id;
+    double s;           // smoothed s position [m]
+    double v;           // smoothed speed along the road [m/s]
+    double a;           // smoothed acceleration along the road [m/s2]
+    double d;           // smoothed d position [m]
+    double vd;          // smoothed lateral velocity [m/s], positive towards the right lanes
+    double P[3][3];     // covariance of [s, v, a]
+    double Pd[2][2];    // covariance of [d, vd]
+    unsigned age;       // number of measurements folded in so far
+    unsigned last_seen; // tracker frame of the last measurement
+};
+
+// Multi-object tracker keyed by the sensor fusion id. Tracks live in a flat open-addressing table
+// (linear probing, power-of-two capacity) that is sized once in the constructor, so update() does
+// not touch the heap in steady state. Vehicles that stop being reported are dropped after a few
+// frames; if the table is full, extra vehicles are passed through unfiltered.
+class VehicleTracker
+{
+public:
+    explicit VehicleTracker(std::size_t max_tracks = 256, double max_s = 6945.554);
+
+    // Fold in one sensor fusion frame, taken dt seconds after the previous one.
+    // Afterwards speed(), accel() and lateralVelocity() hold the estimates of the frame's vehicles,
+    // row-aligned with sensor_fusion.
+    void update(const SensorFusionFrame &sensor_fusion, double dt);
+
+    // Track for the given id, or nullptr if the vehicle is not tracked
+    const Track *find(int id) const;
+
+    const std::vector<double> &speed() const { return speed_; }
+    const std::vector<double> &accel() const { return accel_; }
+    const std::vector<double> &lateralVelocity() const { return lateral_v_; }
+
+    std::size_t size() const { return count_; }
+    std::size_t capacity() const { return max_tracks_; }
+    void clear();
+
+    // number of frames a track survives without measurements
+    unsigned max_missed_frames = 10;
+    // white jerk spectral density of the longitudinal model [m2/s5]
+    double q_jerk = 4.0;
+    // white acceleration spectral density of the lateral model [m2/s3]
+    double q_lateral = 1.0;
+    // measurement noise of s [m], speed [m/s] and d [m]
+    double sigma_s = 0.5;
+    double sigma_v = 0.3;
+    double sigma_d = 0.1;
+
+private:
+    enum SlotState : std::uint8_t { kEmpty = 0, kUsed = 1, kDeleted = 2 };
+
+    std::size_t slotFor(int id) const;
+    Track *insert(int id);
+    void initTrack(Track &track, int id, double s, double v, double d) const;
+    void predict(Track &track, double dt) const;
+    void correct(Track &track, double s, double v, double d) const;
+    void evictStale();
+    void rehash();
+
+    std::size_t max_tracks_;
+    std::size_t mask_;
+    std::size_t count_;
+    std::size_t deleted_;
+    unsigned frame_;
+    double max_s_;
+
+    std::vector<Track> slots_;
+    std::vector<std::uint8_t> state_;
+    std::vector<Track> rehash_slots_;
+    std::vector<std::uint8_t> rehash_state_;
+
+    std::vector<double> speed_;
+    std::vector<double> accel_;
+    std::vector<double> lateral_v_;
+};
+
+#endif // TRACKER_H
@@ -0,0 +1,144 @@
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "planner.h"
+#include "scheduler.h"
+#include "tuning.h"
+
+// Sweep the planner constants against closed-loop runs on the headless simulator and report the
+// sets that trade off safety, mean speed and planning cost best.
+//
+//   tune [--mode grid|random|coordinate] [--axes gap,accpf,...] [--episodes 4] [--miles 2] [--cars 12]
+//        [--steps 3] [--max-sets 4096] [--samples 32] [--rounds 2] [--seed 1] [--threads 0]
+//        [--map ../data/highway_map.csv]
+
+int main(int argc, char *argv[])
+{
+    std::string map_file = "../data/highway_map.csv";
+    std::string mode = "coordinate";
+    std::vector<std::string> axis_names;
+    TuningConfig config;
+    unsigned threads = 0;
+    for (int i = 1; i + 1 < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--mode")
+        {
+            mode = argv[++i];
+        }
+        else if (arg == "--axes")
+        {
+            std::istringstream list(argv[++i]);
+            std::string item;
+            while (std::getline(list, item, ','))
+            {
+                axis_names.push_back(item);
+            }
+        }
+        else if (arg == "--episodes")
+        {
+            config.episodes = atoi(argv[++i]);
+        }
+        else if (arg == "--miles")
+        {
+            config.miles = atof(argv[++i]);
+        }
+        else if (arg == "--cars")
+        {
+            config.cars = atoi(argv[++i]);
+        }
+        else if (arg == "--steps")
+        {
+            config.steps = atoi(argv[++i]);
+        }
+        else if (arg == "--max-sets")
+        {
+            config.max_grid_sets = atoi(argv[++i]);
+        }
+        else if (arg == "--samples")
+        {
+            config.samples = atoi(argv[++i]);
+        }
+        else if (arg == "--rounds")
+        {
+            config.rounds = atoi(argv[++i]);
+        }
+        else if (arg == "--seed")
+        {
+            config.seed = (unsigned) atoi(argv[++i]);
+        }
+        else if (arg == "--threads")
+        {
+            threads = (unsigned) atoi(argv[++i]);
+        }
+        else if (arg == "--map")
+        {
+            map_file = argv[++i];
+        }
+    }
+
+    std::vector<ParamAxis> axes;
+    std::vector<ParamAxis> all_axes = defaultParamAxes();
+    for (std::size_t n = 0; n < axis_names.size(); n++)
+    {
+        std::size_t a = 0;
+        while (a < all_axes.size() && all_axes[a].name != axis_names[n])
+        {
+            a++;
+        }
+        if (a == all_axes.size())
+        {
+            std::cerr << "Unknown parameter " << axis_names[n] << std::endl;
+            return 1;
+        }
+        axes.push_back(all_axes[a]);
+    }
+    if (axes.empty())
+    {
+        axes = all_axes;
+    }
+
+    HighwayMap map;
+    if (!loadHighwayMap(map_file, map))
+    {
+        std::cerr << "Failed to load the map " << map_file << std::endl;
+        return 1;
+    }
+
+    TaskScheduler scheduler(threads);
+    ParamTuner tuner(map, config, scheduler);
+    PlannerParams defaults;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (mode == "grid")
+    {
+        if (!tuner.grid(defaults, axes))
+        {
+            std::cerr << "A grid of " << config.steps << " steps over " << axes.size() << " axes has more than "
+                      << config.max_grid_sets << " sets; pick fewer --axes or --steps, or raise --max-sets"
+                      << std::endl;
+            return 1;
+        }
+    }
+    else if (mode == "random")
+    {
+        tuner.random(defaults, axes);
+    }
+    else if (mode == "coordinate")
+    {
+        tuner.coordinate(defaults, axes);
+    }
+    else
+    {
+        std::cerr << "Unknown mode " << mode << std::endl;
+        return 1;
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    tuner.printReport(axes, std::cout);
+    std::cout << tuner.evaluations().size() * config.episodes << " episodes on " << scheduler.threads()
+              << " threads in " << wall << " s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,328 @@
+#include "tuning.h"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+
+namespace
+{
+
+// The value of the parameter an axis is named after, or nullptr for an unknown name
+double *paramValue(PlannerParams &params, const std::string &name)
+{
+    if (name == "gap") return &params.gap;
+    if (name == "accpf") return &params.accpf;
+    if (name == "slower_ratio") return &params.slower_ratio;
+    if (name == "faster_ratio") return &params.faster_ratio;
+    for (int i = 0; i < 4; i++)
+    {
+        if (name == "wps" + std::to_string(i)) return &params.wps[i];
+        if (name == "par_wps" + std::to_string(i)) return &params.par_wps[i];
+    }
+    return nullptr;
+}
+
+bool validWaypoints(const std::vector<double> &wps)
+{
+    return wps.size() == 4 && wps[0] > 0 && wps[0] < wps[1] && wps[1] < wps[2] && wps[3] > 0 && wps[3] <= wps[2];
+}
+
+// a dominates b if it is at least as good on safety, comfort, speed and cost, and better on one of them
+bool dominates(const Evaluation &a, const Evaluation &b)
+{
+    bool no_worse = a.safety <= b.safety && a.comfort <= b.comfort && a.mean_speed >= b.mean_speed &&
+                    a.cost_us <= b.cost_us;
+    bool better = a.safety < b.safety || a.comfort < b.comfort || a.mean_speed > b.mean_speed ||
+                  a.cost_us < b.cost_us;
+    return no_worse && better;
+}
+
+}  // namespace
+
+std::vector<ParamAxis> defaultParamAxes()
+{
+    return {
+        {"gap", 15, 40},
+        {"accpf", 0.15, 0.45},
+        {"slower_ratio", 0.6, 1.0},
+        {"faster_ratio", 1.0, 1.5},
+        {"wps0", 15, 40},
+        {"wps1", 35, 70},
+        {"wps2", 55, 110},
+        {"wps3", 15, 40},
+        {"par_wps0", 35, 75},
+        {"par_wps1", 60, 120},
+        {"par_wps2", 90, 180},
+        {"par_wps3", 25, 60},
+    };
+}
+
+bool getParam(const PlannerParams &params, const std::string &name, double &value)
+{
+    double *p = paramValue(const_cast<PlannerParams &>(params), name);
+    if (p == nullptr)
+    {
+        return false;
+    }
+    value = *p;
+    return true;
+}
+
+bool setParam(PlannerParams &params, const std::string &name, double value)
+{
+    double *p = paramValue(params, name);
+    if (p == nullptr)
+    {
+        return false;
+    }
+    *p = value;
+    return true;
+}
+
+bool validParams(const PlannerParams &params)
+{
+    return params.gap > 0 && params.accpf > 0 && validWaypoints(params.wps) && validWaypoints(params.par_wps);
+}
+
+ParamTuner::ParamTuner(const HighwayMap &map, const TuningConfig &config, TaskScheduler &scheduler)
+    : map_(map), config_(config), scheduler_(scheduler), rejected_(0)
+{
+}
+
+void ParamTuner::evaluate(const std::vector<PlannerParams> &batch)
+{
+    // the episodes of a chunk and their latency samples are alive at the same time
+    std::size_t chunk = (std::size_t) std::max(1, config_.batch_sets);
+    std::vector<PlannerParams> sets;
+    for (std::size_t i = 0; i < batch.size(); i++)
+    {
+        if (validParams(batch[i]))
+        {
+            sets.push_back(batch[i]);
+        }
+        else
+        {
+            rejected_++;
+        }
+        if (sets.size() == chunk || (i + 1 == batch.size() && !sets.empty()))
+        {
+            evaluateChunk(sets);
+            sets.clear();
+        }
+    }
+}
+
+void ParamTuner::evaluateChunk(const std::vector<PlannerParams> &sets)
+{
+    // the same seeds for every set, so the sets are compared on the same traffic
+    std::vector<EpisodeSpec> specs;
+    for (std::size_t i = 0; i < sets.size(); i++)
+    {
+        for (int e = 0; e < config_.episodes; e++)
+        {
+            EpisodeSpec spec;
+            spec.seed = config_.seed + e;
+            spec.cars = config_.cars;
+            spec.miles = config_.miles;
+            spec.params = sets[i];
+            specs.push_back(spec);
+        }
+    }
+    std::vector<EpisodeResult> results;
+    runEpisodes(map_, specs, scheduler_, results);
+
+    for (std::size_t i = 0; i < sets.size(); i++)
+    {
+        std::vector<const EpisodeResult *> episodes;
+        for (int e = 0; e < config_.episodes; e++)
+        {
+            episodes.push_back(&results[i * config_.episodes + e]);
+        }
+        Evaluation evaluation;
+        evaluation.params = sets[i];
+        evaluation.summary = summarizeEpisodes(episodes);
+        double per_100_miles = evaluation.summary.miles > 0 ? 100.0 / evaluation.summary.miles : 0.0;
+        evaluation.safety = per_100_miles * (evaluation.summary.collisions + evaluation.summary.off_lane_seconds);
+        evaluation.comfort = per_100_miles * evaluation.summary.comfort_violations;
+        evaluation.mean_speed = evaluation.summary.mean_speed;
+        evaluation.cost_us = evaluation.summary.latency_p50;
+        evaluation.score = config_.safety_weight * evaluation.safety - evaluation.mean_speed +
+                           config_.cost_weight * evaluation.cost_us;
+        evaluations_.push_back(evaluation);
+    }
+}
+
+bool ParamTuner::grid(const PlannerParams &base, const std::vector<ParamAxis> &axes)
+{
+    int steps = std::max(1, config_.steps);
+    double sets = 1.0;
+    for (std::size_t a = 0; a < axes.size(); a++)
+    {
+        sets *= steps;
+    }
+    if (sets > config_.max_grid_sets)
+    {
+        return false;
+    }
+
+    // the grid goes to evaluate() one chunk at a time, so only a chunk of it is held at once
+    std::size_t chunk = (std::size_t) std::max(1, config_.batch_sets);
+    std::vector<PlannerParams> batch(1, base);
+    std::vector<int> index(axes.size(), 0);
+    while (true)
+    {
+        PlannerParams params = base;
+        for (std::size_t a = 0; a < axes.size(); a++)
+        {
+            double t = steps > 1 ? (double) index[a] / (steps - 1) : 0.5;
+            setParam(params, axes[a].name, axes[a].lo + t * (axes[a].hi - axes[a].lo));
+        }
+        batch.push_back(params);
+        if (batch.size() == chunk)
+        {
+            evaluate(batch);
+            batch.clear();
+        }
+
+        // next combination, the first axis counting fastest
+        std::size_t a = 0;
+        while (a < axes.size() && ++index[a] == steps)
+        {
+            index[a++] = 0;
+        }
+        if (a == axes.size())
+        {
+            break;
+        }
+    }
+    evaluate(batch);
+    return true;
+}
+
+void ParamTuner::random(const PlannerParams &base, const std::vector<ParamAxis> &axes)
+{
+    std::mt19937 rng(config_.seed);
+    std::vector<PlannerParams> batch(1, base);
+    for (int i = 0; i < config_.samples; i++)
+    {
+        PlannerParams params = base;
+        for (std::size_t a = 0; a < axes.size(); a++)
+        {
+            std::uniform_real_distribution<double> value(axes[a].lo, axes[a].hi);
+            setParam(params, axes[a].name, value(rng));
+        }
+        batch.push_back(params);
+    }
+    evaluate(batch);
+}
+
+void ParamTuner::coordinate(const PlannerParams &base, const std::vector<ParamAxis> &axes)
+{
+    evaluate(std::vector<PlannerParams>(1, base));
+    if (evaluations_.empty())
+    {
+        return;
+    }
+    Evaluation current = evaluations_.back();
+    int steps = std::max(2, config_.steps);
+    for (int round = 0; round < config_.rounds; round++)
+    {
+        for (std::size_t a = 0; a < axes.size(); a++)
+        {
+            // the window around the current value halves every round
+            double center = 0.0;
+            getParam(current.params, axes[a].name, center);
+            double half = 0.5 * (axes[a].hi - axes[a].lo) / (1 << round);
+            double lo = std::max(axes[a].lo, center - half);
+            double hi = std::min(axes[a].hi, center + half);
+
+            std::vector<PlannerParams> batch;
+            for (int i = 0; i < steps; i++)
+            {
+                PlannerParams params = current.params;
+                setParam(params, axes[a].name, lo + (hi - lo) * i / (steps - 1));
+                batch.push_back(params);
+            }
+            std::size_t first = evaluations_.size();
+            evaluate(batch);
+            for (std::size_t i = first; i < evaluations_.size(); i++)
+            {
+                if (evaluations_[i].score < current.score)
+                {
+                    current = evaluations_[i];
+                }
+            }
+        }
+    }
+}
+
+const Evaluation *ParamTuner::best() const
+{
+    const Evaluation *best = nullptr;
+    for (std::size_t i = 0; i < evaluations_.size(); i++)
+    {
+        if (best == nullptr || evaluations_[i].score < best->score)
+        {
+            best = &evaluations_[i];
+        }
+    }
+    return best;
+}
+
+std::vector<const Evaluation *> ParamTuner::paretoFront() const
+{
+    std::vector<const Evaluation *> front;
+    for (std::size_t i = 0; i < evaluations_.size(); i++)
+    {
+        bool dominated = false;
+        for (std::size_t j = 0; j < evaluations_.size() && !dominated; j++)
+        {
+            dominated = j != i && dominates(evaluations_[j], evaluations_[i]);
+        }
+        if (!dominated)
+        {
+            front.push_back(&evaluations_[i]);
+        }
+    }
+    std::sort(front.begin(), front.end(), [](const Evaluation *a, const Evaluation *b) {
+        if (a->safety != b->safety)
+        {
+            return a->safety < b->safety;
+        }
+        return a->mean_speed > b->mean_speed;
+    });
+    return front;
+}
+
+void ParamTuner::printReport(const std::vector<ParamAxis> &axes, std::ostream &out) const
+{
+    char cell[64];
+    std::string header = "     safety    comfort    mph  p50 us  clean   score";
+    for (std::size_t a = 0; a < axes.size(); a++)
+    {
+        snprintf(cell, sizeof(cell), " %12s", axes[a].name.c_str());
+        header += cell;
+    }
+
+    const Evaluation *best_set = best();
+    std::vector<const Evaluation *> front = paretoFront();
+    out << evaluations_.size() << " parameter sets evaluated, " << rejected_
+        << " left out as invalid (spline anchors out of order), " << front.size() << " on the Pareto front of safety, comfort, speed and planning cost (* lowest score)\n"
+        << "per 100 miles, safety: collisions + seconds out of lane, comfort: acceleration and jerk violations\n";
+    out << header << "\n";
+    for (std::size_t i = 0; i < front.size(); i++)
+    {
+        const Evaluation &e = *front[i];
+        snprintf(cell, sizeof(cell), "%c%10.2f %10.2f %6.1f %7.1f %3d/%-3d %7.2f", &e == best_set ? '*' : ' ',
+                e.safety, e.comfort, e.mean_speed, e.cost_us, e.summary.clean_episodes, e.summary.episodes,
+                e.score);
+        std::string line = cell;
+        for (std::size_t a = 0; a < axes.size(); a++)
+        {
+            double value = 0.0;
+            getParam(e.params, axes[a].name, value);
+            snprintf(cell, sizeof(cell), " %12.3f", value);
+            line += cell;
+        }
+        out << line << "\n";
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef TUNING_H
+#define TUNING_H
+
+#include <ostream>
+#include <string>
+#include <vector>
+#include "episodes.h"
+#include "planner.h"
+#include "scheduler.h"
+
+// One tunable value of PlannerParams and the range it is searched over
+struct ParamAxis
+{
+    std::string name;
+    double lo;
+    double hi;
+};
+
+// Every value of PlannerParams with a sensible search range around its default
+std::vector<ParamAxis> defaultParamAxes();
+
+// Read and write the value an axis stands for; false if there is no value of that name
+bool getParam(const PlannerParams &params, const std::string &name, double &value);
+bool setParam(PlannerParams &params, const std::string &name, double value);
+
+// The spline anchors have to be increasing and the spread distance has to lie before the last one
+bool validParams(const PlannerParams &params);
+
+struct TuningConfig
+{
+    // closed-loop episodes every parameter set is scored on; all sets see the same seeds
+    int episodes = 4;
+    double miles = 2.0;
+    int cars = 12;
+    unsigned seed = 1;
+    // grid: values per axis; coordinate: values tried per axis and round
+    int steps = 3;
+    // grid: a grid of more sets than this is refused
+    int max_grid_sets = 4096;
+    // sets whose episodes run (and keep their latency samples) at the same time
+    int batch_sets = 32;
+    // random: parameter sets drawn
+    int samples = 32;
+    // coordinate: passes over all axes, each narrowing the range around the best value
+    int rounds = 2;
+    // scalar score for the coordinate search, lower is better:
+    //   safety_weight * safety - mean speed in mph + cost_weight * p50 latency in us
+    double safety_weight = 1.0;
+    double cost_weight = 0.01;
+};
+
+// The score of one parameter set
+struct Evaluation
+{
+    PlannerParams params;
+    EpisodeSummary summary;
+    // collisions plus seconds out of lane, per 100 miles; an off-lane second weighs like a collision
+    double safety = 0.0;
+    // acceleration and jerk violations per 100 miles
+    double comfort = 0.0;
+    double mean_speed = 0.0;        // mph
+    double cost_us = 0.0;           // median planner call
+    double score = 0.0;
+};
+
+// Grid, random and coordinate search over the given axes. Every parameter set is run for
+// config.episodes episodes, and all episodes of a batch of sets run in parallel on the scheduler.
+class ParamTuner
+{
+public:
+    ParamTuner(const HighwayMap &map, const TuningConfig &config, TaskScheduler &scheduler);
+
+    // config.steps values per axis, every combination; false without evaluating anything if that is more
+    // than config.max_grid_sets sets
+    bool grid(const PlannerParams &base, const std::vector<ParamAxis> &axes);
+    // config.samples sets drawn uniformly from the axes' ranges
+    void random(const PlannerParams &base, const std::vector<ParamAxis> &axes);
+    // one axis at a time, keeping the best value before moving on to the next
+    void coordinate(const PlannerParams &base, const std::vector<ParamAxis> &axes);
+
+    // every set evaluated so far
+    const std::vector<Evaluation> &evaluations() const { return evaluations_; }
+    // sets left out because they failed validParams, e.g. where the ranges of wps0 and wps1 overlap
+    int rejected() const { return rejected_; }
+    const Evaluation *best() const;
+
+    // The sets no other set beats on safety, comfort, speed and planning cost at once, safest first
+    std::vector<const Evaluation *> paretoFront() const;
+    void printReport(const std::vector<ParamAxis> &axes, std::ostream &out) const;
+
+private:
+    // Evaluate a batch of sets, config.batch_sets at a time in parallel, and append them to evaluations_
+    void evaluate(const std::vector<PlannerParams> &batch);
+    void evaluateChunk(const std::vector<PlannerParams> &sets);
+
+    const HighwayMap &map_;
+    TuningConfig config_;
+    TaskScheduler &scheduler_;
+    std::vector<Evaluation> evaluations_;
+    int rejected_;
+};
+
+#endif // TUNING_H